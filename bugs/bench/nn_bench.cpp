@@ -0,0 +1,202 @@
+#include <bitset>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <nn.hpp>
+#include <test_data.hpp>
+
+// Замеры скорости NeuralNetwork: Apply, ApplyBatch, TrainIteration и эпохи Train по матрице форм, активаций
+// и размеров батча. Результат - CSV в stdout, по строке на замер:
+//   benchmark,shape,activation,scalar,batch,samples,seconds,samples_per_s,ns_per_sample,gflops
+// GFLOP/s номинальные: 2 операции на вес плотных слоёв за прямой проход и 6 за шаг обучения, без учёта того,
+// что первый слой на бинарном входе складывает только столбцы установленных битов.
+//
+// Запуск: nn_bench [--quick] [--baseline old.csv] [--tolerance 0.2]
+// С --baseline замеры сравниваются с прошлым выводом по samples_per_s; замедление больше tolerance
+// печатается в stderr и даёт код возврата 1. Сравнивать имеет смысл только Release-сборки одной машины.
+
+namespace {
+
+struct Config {
+    bool quick = false;
+    double min_seconds = 0.2; // каждый замер повторяется, пока не наберёт столько времени
+    std::size_t dataset_size = 4096;
+};
+
+struct Result {
+    std::string benchmark, shape, activation, scalar;
+    std::size_t batch = 0, samples = 0;
+    double seconds = 0, flops_per_sample = 0;
+
+    std::string key() const {
+        return benchmark + "," + shape + "," + activation + "," + scalar + "," + std::to_string(batch);
+    }
+    double samples_per_s() const { return samples / seconds; }
+};
+
+// повторяет run(), пока суммарное время меньше min_seconds; run возвращает число обработанных сэмплов
+template <typename Run>
+std::pair<std::size_t, double> measure(const Config &config, Run &&run) {
+    using clock = std::chrono::steady_clock;
+    std::size_t samples = 0;
+    auto start = clock::now();
+    double seconds = 0;
+    do {
+        samples += run();
+        seconds = std::chrono::duration<double>(clock::now() - start).count();
+    } while (seconds < config.min_seconds);
+    return {samples, seconds};
+}
+
+template <typename Net>
+void run_net(const Config &config, const std::string &activation, std::vector<Result> &results) {
+    using Scalar = typename Net::ScalarType;
+    const std::string shape = std::to_string(Net::Inputs) + "/" + std::to_string(Net::Layers) + "/" +
+                              std::to_string(Net::Hidden) + "/" + std::to_string(Net::Outputs);
+    const std::string scalar = sizeof(Scalar) == sizeof(float) ? "float" : "double";
+    const double weights = double(Net::Inputs * Net::Hidden + (Net::Layers - 1) * Net::Hidden * Net::Hidden +
+                                  Net::Hidden * Net::Outputs);
+
+    std::mt19937 gen(1);
+    auto dataset = test_data::bit_dataset<Net>(config.dataset_size, gen);
+    std::vector<std::bitset<Net::Inputs>> inputs;
+    for (const auto &sample : dataset) {
+        inputs.push_back(sample.first);
+    }
+
+    auto add = [&](const std::string &benchmark, std::size_t batch, double flops, std::pair<std::size_t, double> m) {
+        results.push_back({benchmark, shape, activation, scalar, batch, m.first, m.second, flops * weights});
+    };
+
+    Net net(1);
+    std::size_t sink = 0; // чтобы результаты Apply не выбрасывались оптимизатором
+    add("apply", 1, 2, measure(config, [&] {
+            for (const auto &input : inputs) {
+                sink += net.Apply(input).count();
+            }
+            return inputs.size();
+        }));
+
+    typename Net::BatchWorkspace ws;
+    for (std::size_t batch : {16, 64, 256}) {
+        std::vector<Scalar> probabilities(batch * Net::Outputs);
+        add("apply_batch", batch, 2, measure(config, [&] {
+                for (std::size_t begin = 0; begin + batch <= inputs.size(); begin += batch) {
+                    net.ApplyBatch(inputs.data() + begin, batch, probabilities.data(), ws);
+                }
+                sink += probabilities[0] > Scalar(0.5);
+                return inputs.size() / batch * batch;
+            }));
+    }
+
+    add("train_iteration", 1, 6, measure(config, [&] {
+            for (const auto &[input, target] : dataset) {
+                net.TrainIteration(input, target, 0.01, 1e-6);
+            }
+            return dataset.size();
+        }));
+
+    for (std::size_t batch : {1, 16, 64}) {
+        Net trained(2);
+        add("epoch", batch, 6, measure(config, [&] {
+                return trained.Train(dataset, 0.01, 1, 0, 1e-6, batch) >= 0 ? dataset.size() : 0;
+            }));
+    }
+
+    if (sink == std::size_t(-1)) {
+        std::cerr << sink << std::endl;
+    }
+}
+
+template <std::size_t In, std::size_t HL, std::size_t HN, std::size_t Out>
+void run_shape(const Config &config, std::vector<Result> &results) {
+    run_net<NeuralNetwork<In, HL, HN, Out, ActivationFunction::Sigmoid>>(config, "sigmoid", results);
+    run_net<NeuralNetwork<In, HL, HN, Out, ActivationFunction::LeakyReLU>>(config, "leaky_relu", results);
+    run_net<NeuralNetwork<In, HL, HN, Out, ActivationFunction::Sigmoid, float>>(config, "sigmoid", results);
+    run_net<NeuralNetwork<In, HL, HN, Out, ActivationFunction::LeakyReLU, float>>(config, "leaky_relu", results);
+}
+
+// samples_per_s прошлого вывода по ключу замера
+std::map<std::string, double> read_baseline(const std::string &filename) {
+    std::map<std::string, double> baseline;
+    std::ifstream file(filename);
+    std::string line;
+    std::getline(file, line); // заголовок
+    while (std::getline(file, line)) {
+        std::vector<std::string> fields;
+        std::stringstream ss(line);
+        for (std::string field; std::getline(ss, field, ',');) {
+            fields.push_back(field);
+        }
+        if (fields.size() == 10) {
+            std::string key = fields[0] + "," + fields[1] + "," + fields[2] + "," + fields[3] + "," + fields[4];
+            baseline[key] = std::stod(fields[7]);
+        }
+    }
+    return baseline;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Config config;
+    std::string baseline_file;
+    double tolerance = 0.2;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--quick") {
+            config.quick = true;
+            config.min_seconds = 0.02;
+            config.dataset_size = 512;
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            baseline_file = argv[++i];
+        } else if (arg == "--tolerance" && i + 1 < argc) {
+            tolerance = std::stod(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--quick] [--baseline old.csv] [--tolerance 0.2]" << std::endl;
+            return 2;
+        }
+    }
+
+    std::vector<Result> results;
+    run_shape<72, 7, 81, 9>(config, results);
+    run_shape<72, 7, 72, 9>(config, results);
+    if (!config.quick) {
+        run_shape<72, 3, 256, 9>(config, results);
+    }
+
+    std::cout << "benchmark,shape,activation,scalar,batch,samples,seconds,samples_per_s,ns_per_sample,gflops\n";
+    for (const auto &r : results) {
+        std::cout << r.key() << "," << r.samples << "," << r.seconds << "," << r.samples_per_s() << ","
+                  << 1e9 / r.samples_per_s() << "," << r.samples_per_s() * r.flops_per_sample * 1e-9 << "\n";
+    }
+    std::cout.flush();
+
+    if (baseline_file.empty()) {
+        return 0;
+    }
+    auto baseline = read_baseline(baseline_file);
+    if (baseline.empty()) {
+        std::cerr << "Cannot read baseline " << baseline_file << std::endl;
+        return 2;
+    }
+    bool regressed = false;
+    for (const auto &r : results) {
+        auto it = baseline.find(r.key());
+        if (it != baseline.end() && r.samples_per_s() < it->second * (1 - tolerance)) {
+            std::cerr << "Regression: " << r.key() << ": " << r.samples_per_s() << " samples/s, baseline "
+                      << it->second << std::endl;
+            regressed = true;
+        }
+    }
+    return regressed ? 1 : 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+enum class ActivationFunction { Sigmoid, LeakyReLU };
+
+// Варианты вычисления сигмоиды для горячих циклов сети. Политика - параметр шаблона NeuralNetwork,
+// у каждой есть apply(x) для float и double.
+
+// точная: std::exp на каждый нейрон
+struct ExactSigmoid {
+    template <typename T>
+    static T apply(T x) {
+        return T(1) / (T(1) + std::exp(-x));
+    }
+};
+
+// Таблица на [-range, range] с линейной интерполяцией, за пределами - насыщение.
+// Ошибка меньше 1e-5 при size = 1024, вне таблицы - меньше sigmoid(-8) ~ 3.4e-4.
+struct SigmoidTable {
+    static constexpr int size = 1024;
+    static constexpr float range = 8.f;
+    static constexpr float step = 2 * range / size;
+
+    SigmoidTable() {
+        for (int k = 0; k <= size; ++k) {
+            values[k] = float(1.0 / (1.0 + std::exp(-(-range + step * k))));
+        }
+        values[size + 1] = values[size]; // для интерполяции в правом крае
+    }
+
+    float operator()(float x) const {
+        float t = (std::clamp(x, -range, range) + range) * (1 / step);
+        int k = int(t);
+        float frac = t - float(k);
+        return values[k] + (values[k + 1] - values[k]) * frac;
+    }
+
+    static const SigmoidTable &instance() {
+        static const SigmoidTable table;
+        return table;
+    }
+
+    std::array<float, size + 2> values;
+};
+
+struct TableSigmoid {
+    template <typename T>
+    static T apply(T x) {
+        return T(table(float(x)));
+    }
+
+    // ссылка на таблицу берётся один раз, без проверки инициализации статика на каждый вызов
+    static inline const SigmoidTable &table = SigmoidTable::instance();
+};
+
+// sigmoid(x) = (1 + tanh(x / 2)) / 2, tanh - дробь Ламберта степени 7/6. Без ветвлений и вызовов,
+// поэтому циклы по строкам векторизуются. Аргумент ограничен 4.97, где дробь ещё не выходит за 1;
+// максимальная ошибка ~5e-5.
+struct RationalSigmoid {
+    template <typename T>
+    static T apply(T x) {
+        T y = std::clamp(x * T(0.5), T(-4.97), T(4.97));
+        T y2 = y * y;
+        T num = y * (T(135135) + y2 * (T(17325) + y2 * (T(378) + y2)));
+        T den = T(135135) + y2 * (T(62370) + y2 * (T(3150) + y2 * T(28)));
+        return T(0.5) + T(0.5) * std::clamp(num / den, T(-1), T(1));
+    }
+};
@@ -0,0 +1,311 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "activations.hpp"
+#include "dataset.hpp"
+#include "nn_kernels.hpp"
+#include "train_metrics.hpp"
+
+// Полностью свёрточная сеть по плоскостям лабиринта (стенки, число посещений) с размером, заданным во время
+// выполнения. Каждый слой - свёртка с нечётным ядром kernel x kernel и дополнением нулями, размер плоскостей
+// не меняется, поэтому выход - output_channels() чисел на каждую клетку: один проход оценивает все позиции
+// лабиринта вместо отдельного вызова MLP или NeuralNetwork на каждую.
+// Свёртка считается через im2col: окна всех клеток раскладываются в матрицу cells x (in * kernel * kernel),
+// строки дополнены нулями до кэш-линии, и слой - одно произведение на матрицу весов из nn_kernels.
+// Активации хранятся по клеткам (cells x channels), так что окно клетки собирается копированием kernel * kernel
+// непрерывных кусков. Скрытые слои с активацией AF, выходной - сигмоида, ошибка и шаг SGD с L2 как в MLP.
+class ConvNet {
+  public:
+    // channels - число каналов от входа к выходу, минимум два; kernels - размер ядра каждого слоя
+    ConvNet(std::size_t rows, std::size_t cols, const std::vector<std::size_t> &channels,
+            const std::vector<std::size_t> &kernels, ActivationFunction af = ActivationFunction::Sigmoid,
+            unsigned seed = std::random_device()())
+        : rows_(rows), cols_(cols), af(af) {
+        assert(channels.size() >= 2 && kernels.size() + 1 == channels.size());
+        std::size_t offset = 0;
+        for (std::size_t l = 0; l + 1 < channels.size(); ++l) {
+            assert(kernels[l] % 2 == 1);
+            Layer layer;
+            layer.in = channels[l];
+            layer.out = channels[l + 1];
+            layer.kernel = kernels[l];
+            layer.width = layer.in * layer.kernel * layer.kernel;
+            layer.stride = nn_kernels::padded<float>(layer.width);
+            layer.weights = offset;
+            offset += layer.out * layer.stride;
+            layer.bias = offset;
+            offset += nn_kernels::padded<float>(layer.out);
+            layers.push_back(layer);
+        }
+        params.assign(offset, 0.f);
+        grad.assign(offset, 0.f);
+
+        for (std::size_t c : channels) {
+            activations.emplace_back(cells() * c, 0.f);
+            errors.emplace_back(cells() * c, 0.f);
+        }
+        std::size_t max_stride = 0;
+        for (const auto &layer : layers) {
+            columns.emplace_back(cells() * layer.stride, 0.f);
+            max_stride = std::max(max_stride, layer.stride);
+        }
+        column_errors.assign(cells() * max_stride, 0.f);
+
+        // Glorot по размеру окна, как у MLP
+        std::mt19937 gen(seed);
+        for (const auto &layer : layers) {
+            float limit = std::sqrt(6.f / float(layer.width + layer.out));
+            std::uniform_real_distribution<float> dist(-limit, limit);
+            for (std::size_t i = 0; i < layer.out; ++i) {
+                float *row = weights(layer, i);
+                for (std::size_t j = 0; j < layer.width; ++j) {
+                    row[j] = dist(gen);
+                }
+            }
+        }
+    }
+
+    std::size_t rows() const { return rows_; }
+    std::size_t cols() const { return cols_; }
+    std::size_t cells() const { return rows_ * cols_; }
+    std::size_t input_channels() const { return layers.front().in; }
+    std::size_t output_channels() const { return layers.back().out; }
+    std::size_t num_parameters() const { return params.size(); }
+
+    // Прямой проход. planes - input_channels() плоскостей rows x cols подряд, как во входе get_sample.
+    // Возвращает cells() x output_channels() выходов сигмоиды, клетки по строкам; указатель действителен
+    // до следующего вызова.
+    const float *Forward(const float *planes) {
+        float *input = activations[0].data();
+        const std::size_t channels = input_channels();
+        for (std::size_t c = 0; c < channels; ++c) {
+            for (std::size_t k = 0; k < cells(); ++k) {
+                input[k * channels + c] = planes[c * cells() + k];
+            }
+        }
+        for (std::size_t l = 0; l < layers.size(); ++l) {
+            const Layer &layer = layers[l];
+            float *col = columns[l].data();
+            float *out = activations[l + 1].data();
+            Im2Col(layer, activations[l].data(), col);
+            nn_kernels::gemm_nt(cells(), layer.out, layer.stride, col, layer.stride, weights(layer, 0), layer.stride,
+                                out, layer.out);
+            const float *b = bias(layer);
+            bool last = l + 1 == layers.size();
+            for (std::size_t k = 0; k < cells(); ++k) {
+                for (std::size_t i = 0; i < layer.out; ++i) {
+                    float sum = out[k * layer.out + i] + b[i];
+                    out[k * layer.out + i] = last ? 1.f / (1.f + std::exp(-sum)) : Activate(sum);
+                }
+            }
+        }
+        return activations.back().data();
+    }
+
+    // Один шаг SGD по одному лабиринту, цели заданы только в клетках positions (индекс i * cols + j),
+    // targets - positions.size() x output_channels(). Возвращает квадратичную ошибку по этим клеткам.
+    double TrainPositions(const float *planes, const std::vector<std::size_t> &positions, const float *targets,
+                          double learning_rate, double l2_lambda) {
+        Forward(planes);
+        const std::size_t outputs = output_channels();
+        const float *output = activations.back().data();
+        float *delta = errors.back().data();
+        std::fill(errors.back().begin(), errors.back().end(), 0.f);
+        double total_error = 0.0;
+        for (std::size_t p = 0; p < positions.size(); ++p) {
+            for (std::size_t i = 0; i < outputs; ++i) {
+                std::size_t k = positions[p] * outputs + i;
+                float diff = targets[p * outputs + i] - output[k];
+                delta[k] += diff * output[k] * (1.f - output[k]);
+                total_error += double(diff) * double(diff);
+            }
+        }
+        Backward(learning_rate, l2_lambda);
+        return total_error;
+    }
+
+    // Обучение по сэмплам get_sample: первые input_channels() плоскостей - вход, следующая отмечает квадрат 3x3
+    // вокруг позиции. Подряд идущие сэмплы одного лабиринта (samples_per_maze в генераторе) дают один проход
+    // и один шаг SGD. on_epoch - метрики каждой эпохи, как у MLP.
+    double Train(const DS &dataset, double learning_rate, std::size_t epochs, double decay_rate, double l2_lambda,
+                 const EpochCallback &on_epoch = {}) {
+#ifndef NDEBUG
+        for (const auto &[input, output] : dataset.samples()) {
+            assert(input.size() == (input_channels() + 1) * cells() && output.size() == output_channels());
+        }
+#endif
+        std::vector<std::size_t> positions;
+        std::vector<float> targets;
+        double last_error = std::numeric_limits<double>::max();
+        EpochTimer timer;
+        for (std::size_t epoch = 0; epoch < epochs; ++epoch) {
+            timer.begin();
+            double current_learning_rate = learning_rate * std::exp(-decay_rate * epoch);
+            double total_error = 0.0;
+            for (std::size_t begin = 0, end; begin < dataset.size(); begin = end) {
+                end = SameMaze(dataset, begin);
+                positions.clear();
+                targets.clear();
+                for (std::size_t k = begin; k < end; ++k) {
+                    positions.push_back(Position(dataset[k].first.data()));
+                    targets.insert(targets.end(), dataset[k].second.begin(), dataset[k].second.end());
+                }
+                total_error += TrainPositions(dataset[begin].first.data(), positions, targets.data(),
+                                              current_learning_rate, l2_lambda);
+            }
+            last_error = total_error;
+            if (on_epoch) {
+                on_epoch(timer.finish(epoch, total_error, current_learning_rate, dataset.size()));
+            }
+        }
+        return last_error;
+    }
+
+    // доля сэмплов, у которых все выходы в их позиции после порога 0.5 совпали с целью
+    double Score(const DS &dataset) {
+        std::size_t correct = 0;
+        for (std::size_t begin = 0, end; begin < dataset.size(); begin = end) {
+            end = SameMaze(dataset, begin);
+            const float *output = Forward(dataset[begin].first.data());
+            for (std::size_t k = begin; k < end; ++k) {
+                const float *cell = output + Position(dataset[k].first.data()) * output_channels();
+                bool same = true;
+                for (std::size_t i = 0; i < output_channels(); ++i) {
+                    same &= (cell[i] > 0.5f) == (dataset[k].second[i] > 0.5f);
+                }
+                correct += same;
+            }
+        }
+        return dataset.size() ? double(correct) / dataset.size() : 0.;
+    }
+
+  private:
+    // смещения в params: веса - out строк по stride (окно по клеткам, внутри клетки по каналам), затем смещения
+    struct Layer {
+        std::size_t in = 0, out = 0, kernel = 0, width = 0, stride = 0;
+        std::size_t weights = 0, bias = 0;
+    };
+
+    float *weights(const Layer &layer, std::size_t row) { return params.data() + layer.weights + row * layer.stride; }
+    float *bias(const Layer &layer) { return params.data() + layer.bias; }
+
+    float Activate(float x) const {
+        return af == ActivationFunction::Sigmoid ? 1.f / (1.f + std::exp(-x)) : (x > 0 ? x : 0.01f * x);
+    }
+
+    float ActivateDerivative(float y) const {
+        return af == ActivationFunction::Sigmoid ? y * (1.f - y) : (y > 0 ? 1.f : 0.01f);
+    }
+
+    // Вызывает f(строка окна, клетка источника) для каждой клетки окна kernel x kernel вокруг клетки k
+    // внутри плоскости; клетки за границей пропускаются.
+    template <typename F>
+    void ForEachWindowCell(const Layer &layer, std::size_t k, F &&f) const {
+        const long half = long(layer.kernel / 2), r = long(k / cols_), c = long(k % cols_);
+        std::size_t t = 0;
+        for (long dr = -half; dr <= half; ++dr) {
+            for (long dc = -half; dc <= half; ++dc, t += layer.in) {
+                long rr = r + dr, cc = c + dc;
+                if (rr >= 0 && rr < long(rows_) && cc >= 0 && cc < long(cols_)) {
+                    f(t, std::size_t(rr) * cols_ + std::size_t(cc));
+                }
+            }
+        }
+    }
+
+    // окна всех клеток в строки col; за границей и в дополнении строки - нули
+    void Im2Col(const Layer &layer, const float *src, float *col) const {
+        for (std::size_t k = 0; k < cells(); ++k) {
+            float *row = col + k * layer.stride;
+            std::fill(row, row + layer.width, 0.f);
+            ForEachWindowCell(layer, k, [&](std::size_t t, std::size_t source) {
+                std::copy(src + source * layer.in, src + (source + 1) * layer.in, row + t);
+            });
+        }
+    }
+
+    // обратная к Im2Col: ошибки окон складываются в ошибки клеток
+    void Col2Im(const Layer &layer, const float *col, float *dst) const {
+        std::fill(dst, dst + cells() * layer.in, 0.f);
+        for (std::size_t k = 0; k < cells(); ++k) {
+            const float *row = col + k * layer.stride;
+            ForEachWindowCell(layer, k, [&](std::size_t t, std::size_t source) {
+                for (std::size_t c = 0; c < layer.in; ++c) {
+                    dst[source * layer.in + c] += row[t + c];
+                }
+            });
+        }
+    }
+
+    // обратный проход от ошибок выходного слоя в errors.back() и шаг SGD
+    void Backward(double learning_rate, double l2_lambda) {
+        const float lr = float(learning_rate);
+        const float decay = float(1.0 - learning_rate * l2_lambda);
+        for (std::size_t l = layers.size(); l-- > 0;) {
+            const Layer &layer = layers[l];
+            const float *delta = errors[l + 1].data();
+
+            // ошибка предыдущего слоя считается до обновления весов этого слоя; для входа она не нужна
+            if (l > 0) {
+                std::fill(column_errors.begin(), column_errors.begin() + cells() * layer.stride, 0.f);
+                nn_kernels::gemm_nn(cells(), layer.stride, layer.out, delta, layer.out, weights(layer, 0),
+                                    layer.stride, column_errors.data(), layer.stride);
+                float *prev = errors[l].data();
+                Col2Im(layer, column_errors.data(), prev);
+                const float *prev_out = activations[l].data();
+                for (std::size_t j = 0; j < cells() * layer.in; ++j) {
+                    prev[j] *= ActivateDerivative(prev_out[j]);
+                }
+            }
+
+            // строки col в дополнении нулевые, поэтому дополнение весов остаётся нулевым
+            float *g = grad.data() + layer.weights;
+            std::fill(g, g + layer.out * layer.stride, 0.f);
+            nn_kernels::gemm_tn(layer.out, layer.stride, cells(), delta, layer.out, columns[l].data(), layer.stride,
+                                g, layer.stride);
+            nn_kernels::axpby(layer.out * layer.stride, lr, g, decay, weights(layer, 0));
+            float *b = bias(layer);
+            for (std::size_t k = 0; k < cells(); ++k) {
+                nn_kernels::axpy(layer.out, lr, delta + k * layer.out, b);
+            }
+        }
+    }
+
+    // конец серии сэмплов с теми же входными плоскостями, что у сэмпла begin
+    std::size_t SameMaze(const DS &dataset, std::size_t begin) const {
+        const std::size_t size = input_channels() * cells();
+        const float *planes = dataset[begin].first.data();
+        std::size_t end = begin + 1;
+        while (end < dataset.size() && std::equal(planes, planes + size, dataset[end].first.data())) {
+            ++end;
+        }
+        return end;
+    }
+
+    // центр квадрата 3x3 из плоскости разметки сэмпла get_sample; разметка должна быть и целиком внутри поля
+    std::size_t Position(const float *input) const {
+        const float *marks = input + input_channels() * cells();
+        std::size_t first = std::find(marks, marks + cells(), 1.f) - marks;
+        assert(first < cells() && first / cols_ + 2 < rows_ && first % cols_ + 2 < cols_);
+        return first + cols_ + 1;
+    }
+
+    std::size_t rows_, cols_;
+    ActivationFunction af;
+    std::vector<Layer> layers;
+    nn_kernels::aligned_vector<float> params;
+    nn_kernels::aligned_vector<float> grad;
+
+    // activations[0] - вход, activations[l + 1] - выход слоя l, всё по клеткам; columns[l] - im2col входа слоя l
+    std::vector<nn_kernels::aligned_vector<float>> activations;
+    std::vector<nn_kernels::aligned_vector<float>> errors;
+    std::vector<nn_kernels::aligned_vector<float>> columns;
+    nn_kernels::aligned_vector<float> column_errors;
+};
@@ -0,0 +1,626 @@
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <hashing.hpp>
+#include <mapped_file.hpp>
+
+template <size_t size>
+std::string to_string(const std::bitset<size> &b) {
+    return b.to_string();
+}
+
+template <size_t size>
+std::bitset<size> from_string(const std::string &s) {
+    return std::bitset<size>(s);
+}
+
+template <size_t size>
+std::string to_csv(const std::bitset<size> &b) {
+    std::string s;
+    for (size_t i = 0; i < size; i++) {
+        s += b[i] ? "1" : "0";
+        if (i < size - 1) {
+            s += ",";
+        }
+    }
+    return s;
+}
+
+// compact float to string
+inline std::string to_string(float f) {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(4) << f;
+    // strip trailing zeros
+    std::string s = ss.str();
+    s.erase(s.find_last_not_of('0') + 1, std::string::npos);
+    // strip trailing point
+    if (s.back() == '.') {
+        s.pop_back();
+    }
+    return s;
+}
+
+template <typename T>
+std::string to_string(const std::vector<T> &v) {
+    std::string s;
+    for (const auto &e : v) {
+        s += to_string(e) + " ";
+    }
+    return s;
+}
+
+template <typename T>
+T from_string(const std::string &s) {
+    T v;
+    std::istringstream iss(s);
+    std::remove_reference_t<decltype(v[0])> e;
+    while (iss >> e) {
+        v.push_back(e);
+    }
+    return v;
+}
+
+template <typename T>
+std::string to_csv(const std::vector<T> &v) {
+    std::string s;
+    for (size_t i = 0; i < v.size(); i++) {
+        s += std::to_string(v[i]);
+        if (i < v.size() - 1) {
+            s += ",";
+        }
+    }
+    return s;
+}
+
+// Упакованный бинарный формат сэмплов get_sample.
+// Вход сэмпла - три плоскости rows x cols: стенки (0/1), нормированное число шагов [0, 1] и маска квадрата 3x3.
+// В файле стенки хранятся битами, шаги - uint16 с фиксированной точкой, маска - координатами центра квадрата,
+// выход - битами. Все числа little-endian, запись фиксированного размера, поэтому доступ к i-му сэмплу O(1).
+namespace packed {
+
+constexpr char magic[8] = {'B', 'U', 'G', 'S', 'P', 'A', 'C', 'K'};
+constexpr uint32_t version = 1;
+constexpr size_t header_size = 64;
+
+inline void put_u16(unsigned char *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+inline uint16_t get_u16(const unsigned char *p) { return uint16_t(p[0] | (p[1] << 8)); }
+
+inline void put_u32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (v >> (8 * i)) & 0xFF;
+    }
+}
+
+inline uint32_t get_u32(const unsigned char *p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; i++) {
+        v |= uint32_t(p[i]) << (8 * i);
+    }
+    return v;
+}
+
+inline void put_u64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = (v >> (8 * i)) & 0xFF;
+    }
+}
+
+inline uint64_t get_u64(const unsigned char *p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        v |= uint64_t(p[i]) << (8 * i);
+    }
+    return v;
+}
+
+struct Layout {
+    uint32_t rows = 21, cols = 31, outputs = 9;
+
+    bool operator==(const Layout &) const = default;
+
+    size_t cells() const { return size_t(rows) * cols; }
+    size_t input_size() const { return cells() * 3; }
+    size_t walls_bytes() const { return (cells() + 7) / 8; }
+    size_t visits_offset() const { return walls_bytes(); }
+    size_t window_offset() const { return visits_offset() + cells() * 2; }
+    size_t output_offset() const { return window_offset() + 2; }
+    size_t record_size() const { return output_offset() + (outputs + 7) / 8; }
+
+    // false, если сэмпл нельзя представить в упакованном виде без потерь по структуре
+    bool pack(const std::vector<float> &input, const std::vector<float> &output, unsigned char *dst) const {
+        if (input.size() != input_size() || output.size() != outputs) {
+            return false;
+        }
+        std::memset(dst, 0, record_size());
+
+        const float *walls = input.data();
+        const float *visits = walls + cells();
+        const float *window = visits + cells();
+
+        for (size_t k = 0; k < cells(); k++) {
+            if (walls[k] != 0 && walls[k] != 1) {
+                return false;
+            }
+            if (walls[k] == 1) {
+                dst[k / 8] |= 1 << (k % 8);
+            }
+            if (visits[k] < 0 || visits[k] > 1) {
+                return false;
+            }
+            put_u16(dst + visits_offset() + 2 * k, uint16_t(std::lround(visits[k] * 65535.f)));
+        }
+
+        // маска - это ровно один квадрат 3x3 из единиц, храним только его центр
+        size_t first = std::find(window, window + cells(), 1.f) - window;
+        if (first == cells()) {
+            return false;
+        }
+        size_t x = first / cols + 1, y = first % cols + 1;
+        if (x + 1 >= rows || y + 1 >= cols || x > 255 || y > 255) {
+            return false;
+        }
+        for (size_t i = 0; i < rows; i++) {
+            for (size_t j = 0; j < cols; j++) {
+                bool inside = i + 1 >= x && i <= x + 1 && j + 1 >= y && j <= y + 1;
+                if (window[i * cols + j] != (inside ? 1.f : 0.f)) {
+                    return false;
+                }
+            }
+        }
+        dst[window_offset()] = static_cast<unsigned char>(x);
+        dst[window_offset() + 1] = static_cast<unsigned char>(y);
+
+        for (size_t k = 0; k < outputs; k++) {
+            if (output[k] != 0 && output[k] != 1) {
+                return false;
+            }
+            if (output[k] == 1) {
+                dst[output_offset() + k / 8] |= 1 << (k % 8);
+            }
+        }
+        return true;
+    }
+
+    void expand_input(const unsigned char *record, float *dst) const {
+        float *walls = dst;
+        float *visits = walls + cells();
+        float *window = visits + cells();
+
+        const unsigned char *v = record + visits_offset();
+        for (size_t k = 0; k < cells(); k++) {
+            walls[k] = (record[k / 8] >> (k % 8)) & 1;
+            visits[k] = get_u16(v + 2 * k) / 65535.f;
+        }
+
+        std::fill(window, window + cells(), 0.f);
+        size_t x = record[window_offset()], y = record[window_offset() + 1];
+        if (x < 1 || x + 1 >= rows || y < 1 || y + 1 >= cols) {
+            return; // испорченная запись: квадрат за пределами поля не рисуем
+        }
+        for (size_t i = x - 1; i <= x + 1; i++) {
+            for (size_t j = y - 1; j <= y + 1; j++) {
+                window[i * cols + j] = 1.f;
+            }
+        }
+    }
+
+    // Ключ повторов входа: стенки и положение квадрата. Шаги - функция лабиринта (pass_maze), а округлены они
+    // в форматах по-разному (текст - 4 знака, упакованный - 1/65535), поэтому в ключ не входят: один и тот же
+    // сэмпл, свежий, прочитанный из текста или из упакованного файла, даёт один ключ.
+    utils::hash128 input_key(const unsigned char *record) const {
+        uint64_t window = record[window_offset()] | uint64_t(record[window_offset() + 1]) << 8;
+        return utils::hash_bytes(record, walls_bytes(), window);
+    }
+
+    void expand_output(const unsigned char *record, float *dst) const {
+        const unsigned char *o = record + output_offset();
+        for (size_t k = 0; k < outputs; k++) {
+            dst[k] = (o[k / 8] >> (k % 8)) & 1;
+        }
+    }
+};
+
+inline void write_header(unsigned char *dst, const Layout &layout, uint64_t count) {
+    std::memset(dst, 0, header_size);
+    std::memcpy(dst, magic, sizeof(magic));
+    put_u32(dst + 8, version);
+    put_u32(dst + 12, layout.rows);
+    put_u32(dst + 16, layout.cols);
+    put_u32(dst + 20, layout.outputs);
+    put_u32(dst + 24, uint32_t(layout.record_size()));
+    put_u64(dst + 32, count);
+}
+
+inline bool read_header(const unsigned char *src, size_t size, Layout &layout, uint64_t &count) {
+    if (size < header_size || std::memcmp(src, magic, sizeof(magic)) != 0 || get_u32(src + 8) != version) {
+        return false;
+    }
+    layout.rows = get_u32(src + 12);
+    layout.cols = get_u32(src + 16);
+    layout.outputs = get_u32(src + 20);
+    count = get_u64(src + 32);
+    // форма сэмпла get_sample фиксирована; чужие размеры дали бы запись за пределы буферов сэмпла
+    if (!(layout == Layout()) || get_u32(src + 24) != layout.record_size()) {
+        return false;
+    }
+    // без умножения count * record_size, которое переполнилось бы на испорченном count
+    return count <= (size - header_size) / layout.record_size();
+}
+
+} // namespace packed
+
+// Read-only представление упакованного датасета поверх mmap.
+// Сэмплы разворачиваются во float только по запросу, весь датасет в куче не материализуется.
+class DatasetView {
+  public:
+    DatasetView() = default;
+    explicit DatasetView(const std::string &filename) { open(filename); }
+
+    bool open(const std::string &filename) {
+        count_ = 0;
+        filename_.clear();
+        if (!file_.open(filename)) {
+            return false;
+        }
+        if (!packed::read_header(file_.data(), file_.size(), layout_, count_)) {
+            file_.close();
+            count_ = 0;
+            return false;
+        }
+        filename_ = filename;
+        return true;
+    }
+
+    bool is_open() const { return file_.is_open(); }
+    const std::string &filename() const { return filename_; }
+    size_t size() const { return count_; }
+    size_t input_size() const { return layout_.input_size(); }
+    size_t output_size() const { return layout_.outputs; }
+    const packed::Layout &layout() const { return layout_; }
+
+    const unsigned char *record(size_t index) const {
+        return file_.data() + packed::header_size + index * layout_.record_size();
+    }
+
+    // dst должен вмещать input_size() / output_size() элементов
+    void expand_input(size_t index, float *dst) const { layout_.expand_input(record(index), dst); }
+    void expand_output(size_t index, float *dst) const { layout_.expand_output(record(index), dst); }
+
+    std::pair<std::vector<float>, std::vector<float>> operator[](size_t index) const {
+        std::pair<std::vector<float>, std::vector<float>> sample{std::vector<float>(input_size()),
+                                                                 std::vector<float>(output_size())};
+        expand_input(index, sample.first.data());
+        expand_output(index, sample.second.data());
+        return sample;
+    }
+
+    // случайный порядок обхода для перемешивания без копирования сэмплов
+    std::vector<size_t> shuffled_indices() const {
+        std::vector<size_t> indices(count_);
+        std::iota(indices.begin(), indices.end(), 0);
+        std::shuffle(indices.begin(), indices.end(), std::mt19937(std::random_device()()));
+        advise_random();
+        return indices;
+    }
+
+    // подсказка ядру, что записи будут читаться вразнобой, без упреждающего чтения
+    void advise_random() const { file_.advise_random(); }
+
+  private:
+    utils::MappedFile file_;
+    std::string filename_;
+    packed::Layout layout_;
+    uint64_t count_ = 0;
+};
+
+template <typename T_IN, typename T_OUT>
+class Dataset {
+  public:
+    Dataset() = default;
+    Dataset(const std::vector<std::pair<T_IN, T_OUT>> &data) : data(data) {}
+    Dataset(const Dataset<T_IN, T_OUT> &d) : data(d.data), seen(d.seen), unique_size(d.unique_size) {}
+    Dataset<T_IN, T_OUT> &operator=(const Dataset<T_IN, T_OUT> &d) {
+        data = d.data;
+        seen = d.seen;
+        unique_size = d.unique_size;
+        return *this;
+    }
+    void add(const T_IN &input, const T_OUT &output) { data.push_back(std::make_pair(input, output)); }
+    void add(const std::pair<T_IN, T_OUT> &p) { data.push_back(p); }
+    void clear() {
+        data.clear();
+        seen.clear();
+        unique_size = 0;
+    }
+    size_t size() const { return data.size(); }
+    const std::vector<std::pair<T_IN, T_OUT>> &samples() const { return data; }
+    // через неконстантный доступ сэмпл может измениться, поэтому уже проверенные unique() проверяются заново
+    std::pair<T_IN, T_OUT> &operator[](size_t index) {
+        forget_unique();
+        return data[index];
+    }
+    const std::pair<T_IN, T_OUT> &operator[](size_t index) const { return data[index]; }
+    void shuffle() {
+        // перемешанные с непроверенными проверенные сэмплы уже не лежат в начале
+        if (unique_size != data.size()) {
+            forget_unique();
+        }
+        std::shuffle(data.begin(), data.end(), std::mt19937(std::random_device()()));
+    }
+
+    // Удаляет сэмплы с повторяющимся входом (выход не учитывается), оставляя первое вхождение.
+    // Инкрементально: первые unique_size сэмплов уже проверены и их ключи лежат в seen,
+    // поэтому после insert() проверяются только новые сэмплы. Ключ см. input_key.
+    void unique() {
+        seen.reserve(data.size());
+        std::vector<unsigned char> buffer;
+        size_t kept = unique_size;
+        for (size_t i = unique_size; i < data.size(); i++) {
+            if (seen.insert(input_key(data[i], buffer))) {
+                if (kept != i) {
+                    data[kept] = std::move(data[i]);
+                }
+                kept++;
+            }
+        }
+        data.erase(data.begin() + kept, data.end());
+        unique_size = data.size();
+        shuffle();
+    }
+    bool write_to_file(const std::string &filename) {
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        file << sizeof(T_IN) << " " << sizeof(T_OUT) << " " << data.size() << std::endl;
+
+        for (const auto &d : data) {
+            file << to_string(d.first) << std::endl;
+            file << to_string(d.second) << std::endl;
+        }
+
+        file.close();
+        return true;
+    }
+
+    // упакованный формат, см. namespace packed; только для сэмплов get_sample
+    bool write_packed(const std::string &filename, const packed::Layout &layout = {}) const {
+        static_assert(std::is_same_v<T_IN, std::vector<float>> && std::is_same_v<T_OUT, std::vector<float>>,
+                      "packed format is defined for float vector samples only");
+
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        std::vector<unsigned char> buffer(std::max(packed::header_size, layout.record_size()));
+        packed::write_header(buffer.data(), layout, data.size());
+        file.write(reinterpret_cast<const char *>(buffer.data()), packed::header_size);
+
+        for (const auto &d : data) {
+            if (!layout.pack(d.first, d.second, buffer.data())) {
+                return false;
+            }
+            file.write(reinterpret_cast<const char *>(buffer.data()), layout.record_size());
+        }
+
+        return bool(file);
+    }
+
+    // Как write_packed, но вместе с записями упакованных файлов views, которые копируются как есть, без
+    // разворачивания во float. Повторы входа среди всех сэмплов отбрасываются с первым вхождением, как в unique();
+    // в памяти держатся только хэши входов. false, если раскладка файла отличается от layout.
+    // filename может быть одним из views: запись идёт во временный файл рядом, отображения filename закрываются
+    // перед заменой (отображённый файл в Windows не заменить) и открываются заново уже на новом файле.
+    bool write_packed(const std::string &filename, std::vector<DatasetView> &views,
+                      const packed::Layout &layout = {}) const {
+        static_assert(std::is_same_v<T_IN, std::vector<float>> && std::is_same_v<T_OUT, std::vector<float>>,
+                      "packed format is defined for float vector samples only");
+        for (const auto &view : views) {
+            if (!(view.layout() == layout)) {
+                return false;
+            }
+        }
+
+        const std::string temp = filename + ".tmp";
+        if (!write_packed_merged(temp, views, layout)) {
+            std::remove(temp.c_str());
+            return false;
+        }
+
+        std::error_code ec;
+        std::vector<size_t> replaced;
+        for (size_t i = 0; i < views.size(); i++) {
+            if (std::filesystem::equivalent(views[i].filename(), filename, ec)) {
+                views[i] = DatasetView();
+                replaced.push_back(i);
+            }
+        }
+        std::filesystem::rename(temp, filename, ec);
+        bool ok = !ec;
+        if (!ok) {
+            std::remove(temp.c_str());
+        }
+        for (size_t i : replaced) {
+            views[i].open(filename);
+        }
+        return ok;
+    }
+
+    bool read_from_file(const std::string &filename) {
+        if constexpr (std::is_same_v<T_IN, std::vector<float>> && std::is_same_v<T_OUT, std::vector<float>>) {
+            DatasetView view;
+            if (view.open(filename)) {
+                data.reserve(data.size() + view.size());
+                for (size_t i = 0; i < view.size(); i++) {
+                    data.push_back(view[i]);
+                }
+                return true;
+            }
+        }
+
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        size_t size;
+        size_t size_in, size_out;
+
+        file >> size_in >> size_out >> size;
+
+        if (size_in != sizeof(T_IN) || size_out != sizeof(T_OUT)) {
+            return false;
+        }
+
+        // остаток строки заголовка
+        file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+        data.reserve(data.size() + size);
+
+        for (size_t i = 0; i < size; i++) {
+            std::string in;
+            std::string out;
+
+            std::getline(file, in);
+            std::getline(file, out);
+
+            T_IN input = from_string<T_IN>(in);
+            T_OUT output = from_string<T_OUT>(out);
+
+            data.push_back(std::make_pair(input, output));
+        }
+
+        file.close();
+
+        return true;
+    }
+
+    bool operator==(const Dataset<T_IN, T_OUT> &d) const {
+        if (data.size() != d.data.size()) {
+            return false;
+        }
+
+        for (size_t i = 0; i < data.size(); i++) {
+            if (data[i].first != d.data[i].first || data[i].second != d.data[i].second) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool operator!=(const Dataset<T_IN, T_OUT> &d) const { return !(*this == d); }
+
+    bool save_as_csv(const std::string &filename) {
+        std::ofstream file(filename);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        for (auto &d : data) {
+            file << to_csv(d.first) << "," << to_csv(d.second) << std::endl;
+        }
+
+        file.close();
+
+        return true;
+    }
+
+    void insert(const Dataset<T_IN, T_OUT> &d) { data.insert(data.end(), d.data.begin(), d.data.end()); }
+
+  private:
+    void forget_unique() {
+        seen.clear();
+        unique_size = 0;
+    }
+
+    // Ключ входа, одинаковый для сэмпла и его копии, прошедшей через текстовый или упакованный файл.
+    // Сэмплы get_sample - packed::Layout::input_key, прочие - значения, округлённые до 4 знаков, как в тексте.
+    static utils::hash128 input_key(const std::pair<T_IN, T_OUT> &sample, std::vector<unsigned char> &buffer) {
+        if constexpr (std::is_same_v<T_IN, std::vector<float>> && std::is_same_v<T_OUT, std::vector<float>>) {
+            const packed::Layout layout;
+            static const std::vector<float> no_output(layout.outputs, 0.f); // ключ не зависит от выхода
+            buffer.resize(layout.record_size());
+            if (layout.pack(sample.first, no_output, buffer.data())) {
+                return layout.input_key(buffer.data());
+            }
+            std::vector<int32_t> rounded(sample.first.size());
+            for (size_t k = 0; k < rounded.size(); k++) {
+                rounded[k] = int32_t(std::lround(sample.first[k] * 10000.f));
+            }
+            return utils::content_hash(rounded);
+        } else {
+            return utils::content_hash(sample.first);
+        }
+    }
+
+    bool write_packed_merged(const std::string &filename, const std::vector<DatasetView> &views,
+                             const packed::Layout &layout) const {
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        // число записей известно только в конце, заголовок переписывается после них
+        std::vector<unsigned char> buffer(std::max(packed::header_size, layout.record_size()));
+        packed::write_header(buffer.data(), layout, 0);
+        file.write(reinterpret_cast<const char *>(buffer.data()), packed::header_size);
+
+        utils::Hash128Set inputs;
+        uint64_t count = 0;
+        auto write = [&](const unsigned char *record) {
+            if (inputs.insert(layout.input_key(record))) {
+                file.write(reinterpret_cast<const char *>(record), layout.record_size());
+                count++;
+            }
+        };
+        for (const auto &d : data) {
+            if (!layout.pack(d.first, d.second, buffer.data())) {
+                return false;
+            }
+            write(buffer.data());
+        }
+        for (const auto &view : views) {
+            for (size_t i = 0; i < view.size(); i++) {
+                write(view.record(i));
+            }
+        }
+
+        packed::write_header(buffer.data(), layout, count);
+        file.seekp(0);
+        file.write(reinterpret_cast<const char *>(buffer.data()), packed::header_size);
+        return bool(file);
+    }
+
+    std::vector<std::pair<T_IN, T_OUT>> data;
+    utils::Hash128Set seen; // ключи входов первых unique_size сэмплов
+    size_t unique_size = 0;
+};
+
+// using Dataset = std::vector<std::pair<std::bitset<72>, std::bitset<9>>>;
+
+using DS = Dataset<std::vector<float>, std::vector<float>>;
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "nn.hpp"
+#include "nn_kernels.hpp"
+
+// Average - среднее вероятностей моделей, Vote - доля моделей, у которых вероятность больше 0.5
+enum class EnsembleCombine { Average, Vote };
+
+// Совместный вывод N сетей одного типа (Net - NeuralNetwork).
+// Входные биты разворачиваются в матрицу один раз на батч, первые слои всех моделей склеены в одну матрицу
+// In x (N * HiddenStride) и считаются одним широким gemm. Следующие слои у моделей разные, для них веса
+// транспонированы заранее, чтобы на каждом батче считать gemm_nn без транспонирования B внутри gemm_nt.
+// Веса копируются в конструкторе, изменения исходных сетей после него не видны.
+template <typename Net>
+class Ensemble {
+  public:
+    using Scalar = typename Net::ScalarType;
+    static constexpr std::size_t In = Net::Inputs, HL = Net::Layers, H = Net::Hidden, Out = Net::Outputs;
+    static constexpr std::size_t S = Net::HiddenStride;
+
+    // буферы батча, переиспользуются между вызовами
+    struct Workspace {
+        std::vector<Scalar> input;                    // batch x In
+        nn_kernels::aligned_vector<Scalar> hidden[2]; // batch x (N * S), слои по очереди
+        nn_kernels::aligned_vector<Scalar> output;    // batch x Out одной модели
+    };
+
+    explicit Ensemble(const std::vector<Net> &models)
+        : models_(models.size()), input_hidden_(In * Width(), Scalar(0)), bias_hidden_(Width(), Scalar(0)),
+          hidden_hidden_(models_ * (HL - 1) * H * H), hidden_output_(models_ * H * Out),
+          bias_output_(models_ * Out) {
+        for (std::size_t m = 0; m < models_; ++m) {
+            const Net &net = models[m];
+            for (std::size_t j = 0; j < In; ++j) {
+                std::copy(net.weights_input_hidden_[j].begin(), net.weights_input_hidden_[j].end(),
+                          input_hidden_.begin() + j * Width() + m * S);
+            }
+            std::copy(net.bias_hidden_.begin(), net.bias_hidden_.end(), bias_hidden_.begin() + m * S);
+            for (std::size_t h = 0; h + 1 < HL; ++h) {
+                Scalar *t = HiddenHidden(m, h);
+                for (std::size_t i = 0; i < H; ++i) {
+                    for (std::size_t p = 0; p < H; ++p) {
+                        t[p * H + i] = net.weights_hidden_hidden_[h][i][p];
+                    }
+                }
+            }
+            for (std::size_t o = 0; o < Out; ++o) {
+                for (std::size_t p = 0; p < H; ++p) {
+                    hidden_output_[m * H * Out + p * Out + o] = net.weights_hidden_output_[o][p];
+                }
+                bias_output_[m * Out + o] = net.bias_output_[o];
+            }
+        }
+    }
+
+    // Сети из файлов: сначала как бинарные save_binary, затем как текстовые save_to_file
+    static std::optional<Ensemble> Load(const std::vector<std::string> &filenames) {
+        std::vector<Net> models(filenames.size(), Net(0));
+        for (std::size_t m = 0; m < filenames.size(); ++m) {
+            if (!models[m].load_binary(filenames[m]) && !models[m].load_from_file(filenames[m])) {
+                return std::nullopt;
+            }
+        }
+        return Ensemble(models);
+    }
+
+    std::size_t size() const { return models_; }
+
+    // count x Out результатов в values: средние вероятности или доли голосов, порог 0.5 даёт ответ ансамбля
+    void ApplyBatch(const std::bitset<In> *inputs, std::size_t count, Scalar *values, Workspace &ws,
+                    EnsembleCombine combine = EnsembleCombine::Average) const {
+        const std::size_t W = Width();
+        ws.input.assign(count * In, Scalar(0));
+        for (std::size_t b = 0; b < count; ++b) {
+            ForEachSetBit(inputs[b], [&](std::size_t j) { ws.input[b * In + j] = Scalar(1); });
+        }
+        for (auto &buffer : ws.hidden) {
+            buffer.assign(count * W, Scalar(0)); // дополнение строк остаётся нулевым
+        }
+        ws.output.resize(count * Out);
+
+        // первый слой всех моделей одним произведением
+        nn_kernels::gemm_nn(count, W, In, ws.input.data(), In, input_hidden_.data(), W, ws.hidden[0].data(), W);
+        for (std::size_t b = 0; b < count; ++b) {
+            Activate(ws.hidden[0].data() + b * W);
+        }
+
+        for (std::size_t h = 1; h < HL; ++h) {
+            const Scalar *prev = ws.hidden[(h - 1) % 2].data();
+            Scalar *next = ws.hidden[h % 2].data();
+            for (std::size_t m = 0; m < models_; ++m) {
+                for (std::size_t b = 0; b < count; ++b) {
+                    std::fill(next + b * W + m * S, next + b * W + m * S + H, Scalar(0));
+                }
+                nn_kernels::gemm_nn(count, H, H, prev + m * S, W, HiddenHidden(m, h - 1), H, next + m * S, W);
+            }
+            for (std::size_t b = 0; b < count; ++b) {
+                Activate(next + b * W);
+            }
+        }
+
+        std::fill(values, values + count * Out, Scalar(0));
+        const Scalar *last = ws.hidden[(HL - 1) % 2].data();
+        const Scalar weight = Scalar(1) / Scalar(models_);
+        const bool vote = combine == EnsembleCombine::Vote;
+        for (std::size_t m = 0; m < models_; ++m) {
+            std::fill(ws.output.begin(), ws.output.end(), Scalar(0));
+            nn_kernels::gemm_nn(count, Out, H, last + m * S, W, hidden_output_.data() + m * H * Out, Out,
+                                ws.output.data(), Out);
+            for (std::size_t b = 0; b < count; ++b) {
+                for (std::size_t o = 0; o < Out; ++o) {
+                    Scalar p = Net::Sigmoid(ws.output[b * Out + o] + bias_output_[m * Out + o]);
+                    values[b * Out + o] += weight * (vote ? Scalar(p > Scalar(0.5)) : p);
+                }
+            }
+        }
+    }
+
+    std::bitset<Out> Apply(const std::bitset<In> &input, EnsembleCombine combine = EnsembleCombine::Average) const {
+        Workspace ws;
+        Scalar values[Out];
+        ApplyBatch(&input, 1, values, ws, combine);
+        std::bitset<Out> output;
+        for (std::size_t o = 0; o < Out; ++o) {
+            output[o] = values[o] > Scalar(0.5);
+        }
+        return output;
+    }
+
+    double Score(const std::vector<std::pair<std::bitset<In>, std::bitset<Out>>> &dataset,
+                 EnsembleCombine combine = EnsembleCombine::Average) const {
+        constexpr std::size_t batch = 256;
+        Workspace ws;
+        std::vector<std::bitset<In>> inputs(batch);
+        std::vector<Scalar> values(batch * Out);
+        double correct = 0.0;
+        for (std::size_t begin = 0; begin < dataset.size(); begin += batch) {
+            std::size_t count = std::min(batch, dataset.size() - begin);
+            for (std::size_t b = 0; b < count; ++b) {
+                inputs[b] = dataset[begin + b].first;
+            }
+            ApplyBatch(inputs.data(), count, values.data(), ws, combine);
+            for (std::size_t b = 0; b < count; ++b) {
+                bool same = true;
+                for (std::size_t o = 0; o < Out; ++o) {
+                    same &= (values[b * Out + o] > Scalar(0.5)) == dataset[begin + b].second[o];
+                }
+                correct += same;
+            }
+        }
+        return correct / dataset.size();
+    }
+
+  private:
+    std::size_t Width() const { return models_ * S; }
+
+    // H x H, транспонированные веса скрытого слоя h + 1 модели m; дополнение строк не нужно, k = H
+    Scalar *HiddenHidden(std::size_t m, std::size_t h) { return hidden_hidden_.data() + (m * (HL - 1) + h) * H * H; }
+    const Scalar *HiddenHidden(std::size_t m, std::size_t h) const {
+        return hidden_hidden_.data() + (m * (HL - 1) + h) * H * H;
+    }
+
+    // строка из N * S сумм: смещение модели и активация, дополнение не трогается
+    void Activate(Scalar *row) const {
+        for (std::size_t m = 0; m < models_; ++m) {
+            for (std::size_t i = 0; i < H; ++i) {
+                row[m * S + i] = Net::Activate(row[m * S + i] + bias_hidden_[m * S + i]);
+            }
+        }
+    }
+
+    std::size_t models_;
+    nn_kernels::aligned_vector<Scalar> input_hidden_;  // In x (N * S)
+    nn_kernels::aligned_vector<Scalar> bias_hidden_;   // N * S, общие для всех скрытых слоёв модели
+    nn_kernels::aligned_vector<Scalar> hidden_hidden_; // N x (HL - 1) x H x H
+    nn_kernels::aligned_vector<Scalar> hidden_output_; // N x H x Out
+    std::vector<Scalar> bias_output_;                  // N x Out
+};
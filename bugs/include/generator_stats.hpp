@@ -0,0 +1,221 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// Счётчики одного воркера генератора данных.
+// У каждого счётчика ровно один писатель (свой воркер), поэтому обновление - relaxed load + store без lock-префикса,
+// а читатели (меню, дампер) видят значения с небольшой задержкой, что для статистики нормально.
+struct alignas(64) WorkerCounters {
+    std::atomic<uint64_t> samples{0};
+    std::atomic<uint64_t> pass_maze_calls{0};
+    std::atomic<uint64_t> unsolvable{0};       // отказы is_solvable (и в мутациях, и в разметке)
+    std::atomic<uint64_t> mutations_denied{0}; // откаченные мутации
+    std::atomic<uint64_t> mutation_ns{0};      // время в hill climb
+    std::atomic<uint64_t> labelling_ns{0};     // время в get_sample
+    std::atomic<uint64_t> cache_hits{0};       // оценки hill climb, взятые из ScoreCache
+    std::atomic<uint64_t> cache_misses{0};
+
+    static void add(std::atomic<uint64_t> &counter, uint64_t value = 1) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+};
+
+struct CountersSnapshot {
+    uint64_t samples = 0, pass_maze_calls = 0, unsolvable = 0, mutations_denied = 0, mutation_ns = 0,
+             labelling_ns = 0, cache_hits = 0, cache_misses = 0;
+
+    CountersSnapshot() = default;
+    explicit CountersSnapshot(const WorkerCounters &c)
+        : samples(c.samples.load(std::memory_order_relaxed)),
+          pass_maze_calls(c.pass_maze_calls.load(std::memory_order_relaxed)),
+          unsolvable(c.unsolvable.load(std::memory_order_relaxed)),
+          mutations_denied(c.mutations_denied.load(std::memory_order_relaxed)),
+          mutation_ns(c.mutation_ns.load(std::memory_order_relaxed)),
+          labelling_ns(c.labelling_ns.load(std::memory_order_relaxed)),
+          cache_hits(c.cache_hits.load(std::memory_order_relaxed)),
+          cache_misses(c.cache_misses.load(std::memory_order_relaxed)) {}
+
+    CountersSnapshot &operator+=(const CountersSnapshot &o) {
+        samples += o.samples;
+        pass_maze_calls += o.pass_maze_calls;
+        unsolvable += o.unsolvable;
+        mutations_denied += o.mutations_denied;
+        mutation_ns += o.mutation_ns;
+        labelling_ns += o.labelling_ns;
+        cache_hits += o.cache_hits;
+        cache_misses += o.cache_misses;
+        return *this;
+    }
+
+    // доля времени в разметке от всего учтённого времени
+    double labelling_share() const {
+        uint64_t total = mutation_ns + labelling_ns;
+        return total ? double(labelling_ns) / total : 0.;
+    }
+
+    double cache_hit_rate() const {
+        uint64_t total = cache_hits + cache_misses;
+        return total ? double(cache_hits) / total : 0.;
+    }
+};
+
+// замер времени участка кода с добавлением в счётчик
+class ScopedTimer {
+  public:
+    explicit ScopedTimer(std::atomic<uint64_t> *counter)
+        : counter(counter), start(counter ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{}) {}
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+    ~ScopedTimer() { stop(); }
+
+    // досрочное завершение замера, повторные вызовы ничего не делают
+    void stop() {
+        if (counter) {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            WorkerCounters::add(*counter, ns.count());
+            counter = nullptr;
+        }
+    }
+
+  private:
+    std::atomic<uint64_t> *counter;
+    std::chrono::steady_clock::time_point start;
+};
+
+class GeneratorStats {
+  public:
+    explicit GeneratorStats(size_t num_workers)
+        : num_workers(num_workers), workers(new WorkerCounters[num_workers]), start(std::chrono::steady_clock::now()) {}
+
+    WorkerCounters &worker(size_t index) { return workers[index]; }
+    size_t size() const { return num_workers; }
+
+    CountersSnapshot snapshot(size_t index) const { return CountersSnapshot(workers[index]); }
+
+    CountersSnapshot total() const {
+        CountersSnapshot t;
+        for (size_t i = 0; i < num_workers; i++) {
+            t += snapshot(i);
+        }
+        return t;
+    }
+
+    double elapsed_seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    static std::string csv_header() {
+        return "elapsed_s,worker,samples,samples_per_s,pass_maze_calls,unsolvable,mutations_denied,mutation_s,"
+               "labelling_s,cache_hits,cache_misses";
+    }
+
+    // worker = -1 для суммы по всем воркерам
+    std::string csv_line(const CountersSnapshot &s, int worker, double elapsed) const {
+        std::ostringstream ss;
+        ss << elapsed << "," << worker << "," << s.samples << "," << (elapsed > 0 ? s.samples / elapsed : 0.) << ","
+           << s.pass_maze_calls << "," << s.unsolvable << "," << s.mutations_denied << "," << s.mutation_ns * 1e-9
+           << "," << s.labelling_ns * 1e-9 << "," << s.cache_hits << "," << s.cache_misses;
+        return ss.str();
+    }
+
+    std::string json_line(const CountersSnapshot &s, int worker, double elapsed) const {
+        std::ostringstream ss;
+        ss << "{\"elapsed_s\":" << elapsed << ",\"worker\":" << worker << ",\"samples\":" << s.samples
+           << ",\"samples_per_s\":" << (elapsed > 0 ? s.samples / elapsed : 0.)
+           << ",\"pass_maze_calls\":" << s.pass_maze_calls << ",\"unsolvable\":" << s.unsolvable
+           << ",\"mutations_denied\":" << s.mutations_denied << ",\"mutation_s\":" << s.mutation_ns * 1e-9
+           << ",\"labelling_s\":" << s.labelling_ns * 1e-9 << ",\"cache_hits\":" << s.cache_hits
+           << ",\"cache_misses\":" << s.cache_misses << "}";
+        return ss.str();
+    }
+
+    void print(std::ostream &out) const {
+        double elapsed = elapsed_seconds();
+        for (size_t i = 0; i < num_workers; i++) {
+            print_line(out, "Worker " + std::to_string(i), snapshot(i), elapsed);
+        }
+        print_line(out, "Total", total(), elapsed);
+    }
+
+  private:
+    static void print_line(std::ostream &out, const std::string &name, const CountersSnapshot &s, double elapsed) {
+        out << name << ": samples " << s.samples << " (" << (elapsed > 0 ? s.samples / elapsed : 0.)
+            << "/s), pass_maze " << s.pass_maze_calls << ", unsolvable " << s.unsolvable << ", denied "
+            << s.mutations_denied << ", mutation " << s.mutation_ns * 1e-9 << " s, labelling " << s.labelling_ns * 1e-9
+            << " s (" << s.labelling_share() * 100 << "%), cache hits " << s.cache_hits << " ("
+            << s.cache_hit_rate() * 100 << "%)\n";
+    }
+
+    size_t num_workers;
+    std::unique_ptr<WorkerCounters[]> workers;
+    std::chrono::steady_clock::time_point start;
+};
+
+// Периодическая запись статистики в файл: по строке CSV или JSON на воркер и суммарная (worker = -1)
+class StatsDumper {
+  public:
+    enum Format { CSV, JSON };
+
+    StatsDumper(const GeneratorStats &stats, const std::string &filename, Format format,
+                std::chrono::milliseconds period)
+        : stats(stats), file(filename, std::ios::app), format(format), period(period) {
+        if (format == CSV && file.tellp() == 0) {
+            file << GeneratorStats::csv_header() << "\n";
+        }
+        thread = std::thread([this]() { run(); });
+    }
+
+    ~StatsDumper() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+        }
+        cv.notify_all();
+        thread.join();
+    }
+
+    bool is_open() const { return file.is_open(); }
+
+  private:
+    void run() {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (!cv.wait_for(lock, period, [this]() { return stop; })) {
+            dump();
+        }
+        dump();
+    }
+
+    void dump() {
+        double elapsed = stats.elapsed_seconds();
+        for (size_t i = 0; i < stats.size(); i++) {
+            write(stats.snapshot(i), int(i), elapsed);
+        }
+        write(stats.total(), -1, elapsed);
+        file.flush(); // раз в период, не на горячем пути
+    }
+
+    void write(const CountersSnapshot &s, int worker, double elapsed) {
+        file << (format == CSV ? stats.csv_line(s, worker, elapsed) : stats.json_line(s, worker, elapsed)) << "\n";
+    }
+
+    const GeneratorStats &stats;
+    std::ofstream file;
+    Format format;
+    std::chrono::milliseconds period;
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stop = false;
+    std::thread thread;
+};
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace utils {
+
+struct hash128 {
+    uint64_t lo, hi;
+    bool operator==(const hash128 &other) const { return lo == other.lo && hi == other.hi; }
+    bool operator!=(const hash128 &other) const { return !(*this == other); }
+};
+
+inline uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+inline uint64_t fmix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+// MurmurHash3 x64_128
+inline hash128 hash_bytes(const void *key, size_t len, uint64_t seed = 0) {
+    const unsigned char *data = static_cast<const unsigned char *>(key);
+    const size_t nblocks = len / 16;
+
+    uint64_t h1 = seed, h2 = seed;
+    const uint64_t c1 = 0x87c37b91114253d5ULL;
+    const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+    for (size_t i = 0; i < nblocks; i++) {
+        uint64_t k1, k2;
+        std::memcpy(&k1, data + i * 16, 8);
+        std::memcpy(&k2, data + i * 16 + 8, 8);
+
+        k1 *= c1;
+        k1 = rotl64(k1, 31);
+        k1 *= c2;
+        h1 ^= k1;
+        h1 = rotl64(h1, 27);
+        h1 += h2;
+        h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= c2;
+        k2 = rotl64(k2, 33);
+        k2 *= c1;
+        h2 ^= k2;
+        h2 = rotl64(h2, 31);
+        h2 += h1;
+        h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    const unsigned char *tail = data + nblocks * 16;
+    uint64_t k1 = 0, k2 = 0;
+    switch (len & 15) {
+    case 15: k2 ^= uint64_t(tail[14]) << 48; [[fallthrough]];
+    case 14: k2 ^= uint64_t(tail[13]) << 40; [[fallthrough]];
+    case 13: k2 ^= uint64_t(tail[12]) << 32; [[fallthrough]];
+    case 12: k2 ^= uint64_t(tail[11]) << 24; [[fallthrough]];
+    case 11: k2 ^= uint64_t(tail[10]) << 16; [[fallthrough]];
+    case 10: k2 ^= uint64_t(tail[9]) << 8; [[fallthrough]];
+    case 9:
+        k2 ^= uint64_t(tail[8]);
+        k2 *= c2;
+        k2 = rotl64(k2, 33);
+        k2 *= c1;
+        h2 ^= k2;
+        [[fallthrough]];
+    case 8: k1 ^= uint64_t(tail[7]) << 56; [[fallthrough]];
+    case 7: k1 ^= uint64_t(tail[6]) << 48; [[fallthrough]];
+    case 6: k1 ^= uint64_t(tail[5]) << 40; [[fallthrough]];
+    case 5: k1 ^= uint64_t(tail[4]) << 32; [[fallthrough]];
+    case 4: k1 ^= uint64_t(tail[3]) << 24; [[fallthrough]];
+    case 3: k1 ^= uint64_t(tail[2]) << 16; [[fallthrough]];
+    case 2: k1 ^= uint64_t(tail[1]) << 8; [[fallthrough]];
+    case 1:
+        k1 ^= uint64_t(tail[0]);
+        k1 *= c1;
+        k1 = rotl64(k1, 31);
+        k1 *= c2;
+        h1 ^= k1;
+    }
+
+    h1 ^= len;
+    h2 ^= len;
+    h1 += h2;
+    h2 += h1;
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+
+    return {h1, h2};
+}
+
+// хэш содержимого: для векторов - байты элементов, для остального - байты самого объекта
+template <typename T>
+hash128 content_hash(const std::vector<T> &v, uint64_t seed = 0) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    return hash_bytes(v.data(), v.size() * sizeof(T), seed);
+}
+
+template <size_t N>
+hash128 content_hash(const std::bitset<N> &b, uint64_t seed = 0) {
+    // у bitset могут быть неиспользуемые биты в хвосте, поэтому хэшируем только значимые
+    unsigned char bytes[(N + 7) / 8] = {};
+    for (size_t i = 0; i < N; i++) {
+        bytes[i / 8] |= b[i] << (i % 8);
+    }
+    return hash_bytes(bytes, sizeof(bytes), seed);
+}
+
+template <typename T>
+hash128 content_hash(const T &v, uint64_t seed = 0) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    return hash_bytes(&v, sizeof(T), seed);
+}
+
+// Множество 128-битных хэшей с открытой адресацией (линейное пробирование).
+// Коллизия двух 128-битных хэшей на реальных объёмах данных пренебрежимо маловероятна, поэтому сами ключи не храним.
+class Hash128Set {
+  public:
+    Hash128Set() { rehash(16); }
+
+    // true, если хэш новый
+    bool insert(const hash128 &h) {
+        if ((size_ + 1) * 2 > slots_.size()) {
+            rehash(slots_.size() * 2);
+        }
+        return insert_no_grow(h);
+    }
+
+    bool contains(const hash128 &h) const {
+        size_t mask = slots_.size() - 1;
+        for (size_t i = h.lo & mask;; i = (i + 1) & mask) {
+            if (!used_[i]) {
+                return false;
+            }
+            if (slots_[i] == h) {
+                return true;
+            }
+        }
+    }
+
+    void reserve(size_t n) {
+        size_t capacity = slots_.size();
+        while (capacity < n * 2) {
+            capacity *= 2;
+        }
+        if (capacity != slots_.size()) {
+            rehash(capacity);
+        }
+    }
+
+    void clear() {
+        size_ = 0;
+        std::fill(used_.begin(), used_.end(), 0);
+    }
+
+    size_t size() const { return size_; }
+
+  private:
+    bool insert_no_grow(const hash128 &h) {
+        size_t mask = slots_.size() - 1;
+        for (size_t i = h.lo & mask;; i = (i + 1) & mask) {
+            if (!used_[i]) {
+                used_[i] = 1;
+                slots_[i] = h;
+                size_++;
+                return true;
+            }
+            if (slots_[i] == h) {
+                return false;
+            }
+        }
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<hash128> old_slots(capacity);
+        std::vector<unsigned char> old_used(capacity, 0);
+        old_slots.swap(slots_);
+        old_used.swap(used_);
+        size_ = 0;
+        for (size_t i = 0; i < old_slots.size(); i++) {
+            if (old_used[i]) {
+                insert_no_grow(old_slots[i]);
+            }
+        }
+    }
+
+    std::vector<hash128> slots_;
+    std::vector<unsigned char> used_;
+    size_t size_ = 0;
+};
+
+} // namespace utils
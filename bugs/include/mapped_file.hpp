@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace utils {
+
+// Отображение файла в память, без копирования в кучу. ReadOnly - только чтение; CopyOnWrite - страницы можно
+// менять, изменённые становятся собственной памятью процесса, а файл остаётся прежним (веса сети, которую
+// дообучают после загрузки).
+class MappedFile {
+  public:
+    enum Mode { ReadOnly, CopyOnWrite };
+
+    MappedFile() = default;
+    explicit MappedFile(const std::string &filename, Mode mode = ReadOnly) { open(filename, mode); }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) noexcept { swap(other); }
+    MappedFile &operator=(MappedFile &&other) noexcept {
+        if (this != &other) {
+            close();
+            swap(other);
+        }
+        return *this;
+    }
+
+    ~MappedFile() { close(); }
+
+    bool open(const std::string &filename, Mode mode = ReadOnly) {
+        close();
+#ifdef _WIN32
+        file_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file_, &file_size) || file_size.QuadPart == 0) {
+            close();
+            return false;
+        }
+        size_ = static_cast<size_t>(file_size.QuadPart);
+        mapping_ = CreateFileMappingA(file_, nullptr, mode == CopyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0,
+                                      nullptr);
+        if (mapping_ == nullptr) {
+            close();
+            return false;
+        }
+        data_ = static_cast<unsigned char *>(
+            MapViewOfFile(mapping_, mode == CopyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+        if (data_ == nullptr) {
+            close();
+            return false;
+        }
+#else
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        void *p = mmap(nullptr, size_, mode == CopyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // отображение остаётся валидным и после закрытия дескриптора
+        if (p == MAP_FAILED) {
+            size_ = 0;
+            return false;
+        }
+        data_ = static_cast<unsigned char *>(p);
+#endif
+        mode_ = mode;
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (data_) {
+            UnmapViewOfFile(data_);
+        }
+        if (mapping_) {
+            CloseHandle(mapping_);
+        }
+        if (file_ != INVALID_HANDLE_VALUE) {
+            CloseHandle(file_);
+        }
+        mapping_ = nullptr;
+        file_ = INVALID_HANDLE_VALUE;
+#else
+        if (data_) {
+            munmap(data_, size_);
+        }
+#endif
+        data_ = nullptr;
+        size_ = 0;
+        mode_ = ReadOnly;
+    }
+
+    // подсказка ядру, что доступ будет случайным (перемешивание датасета)
+    void advise_random() const {
+#ifndef _WIN32
+        if (data_) {
+            madvise(data_, size_, MADV_RANDOM);
+        }
+#endif
+    }
+
+    bool is_open() const { return data_ != nullptr; }
+    const unsigned char *data() const { return data_; }
+    // nullptr, если файл открыт только для чтения
+    unsigned char *writable_data() const { return mode_ == CopyOnWrite ? data_ : nullptr; }
+    size_t size() const { return size_; }
+
+  private:
+    void swap(MappedFile &other) {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(mode_, other.mode_);
+#ifdef _WIN32
+        std::swap(file_, other.file_);
+        std::swap(mapping_, other.mapping_);
+#endif
+    }
+
+    unsigned char *data_ = nullptr;
+    size_t size_ = 0;
+    Mode mode_ = ReadOnly;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#endif
+};
+
+} // namespace utils
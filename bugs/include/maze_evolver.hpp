@@ -0,0 +1,105 @@
+#pragma once
+
+#include "generator_stats.hpp"
+#include "maze_utils.hpp"
+#include "score_cache.hpp"
+
+namespace utils {
+
+// Долгоживущий hill climb по лабиринту для одного воркера генератора.
+// Лабиринт и MutationManager сохраняются между батчами, поэтому разогрев с пустого лабиринта
+// выполняется один раз, а между сэмплами достаточно нескольких шагов декорреляции.
+template <crd M, crd N>
+class MazeEvolver {
+  public:
+    MazeEvolver() { reset(); }
+
+    MazeEvolver(const MazeEvolver &) = delete;
+    MazeEvolver &operator=(const MazeEvolver &) = delete;
+
+    void reset() {
+        prepare_maze<M, N>(m);
+        score = pass_maze<M, N>(m);
+        clean_maze<M, N>(m);
+        mm.reset_key(m);
+        warmed_up = false;
+    }
+
+    // Общий кэш оценок для нескольких воркеров; nullptr - без кэша. Кэш должен жить дольше эволвера.
+    void set_score_cache(ScoreCache *cache) { score_cache = cache; }
+
+    // Делает accepted_steps принятых мутаций; мутация принимается, если лабиринт остаётся проходимым,
+    // а счёт падает не сильнее чем до score * 0.99 - 10. stats - необязательные счётчики воркера.
+    void evolve(size_t accepted_steps, WorkerCounters *stats = nullptr) {
+        ScopedTimer timer(stats ? &stats->mutation_ns : nullptr);
+        size_t pass_maze_calls = 0, unsolvable = 0, denied = 0, cache_hits = 0, cache_misses = 0;
+
+        for (size_t i = 0; i < accepted_steps;) {
+            mm.apply_random_mutation(m);
+            MazeScore result = evaluate(pass_maze_calls, cache_hits, cache_misses);
+            if (!result.solvable) {
+                mm.deny_last_mutation(m);
+                unsolvable++;
+                denied++;
+                continue;
+            }
+            if (result.score > score * 0.99 - 10) {
+                score = result.score;
+                i++;
+            } else {
+                mm.deny_last_mutation(m);
+                denied++;
+            }
+        }
+
+        if (stats) {
+            WorkerCounters::add(stats->pass_maze_calls, pass_maze_calls);
+            WorkerCounters::add(stats->unsolvable, unsolvable);
+            WorkerCounters::add(stats->mutations_denied, denied);
+            WorkerCounters::add(stats->cache_hits, cache_hits);
+            WorkerCounters::add(stats->cache_misses, cache_misses);
+        }
+    }
+
+    // разогрев warmup_steps при первом вызове, дальше decorrelation_steps между сэмплами
+    void advance(size_t warmup_steps, size_t decorrelation_steps, WorkerCounters *stats = nullptr) {
+        evolve(warmed_up ? decorrelation_steps : warmup_steps, stats);
+        warmed_up = true;
+    }
+
+    size_t get_score() const { return score; }
+    // ключ Zobrist текущего лабиринта, ведётся MutationManager
+    uint64_t get_key() const { return mm.get_key(); }
+
+    maze<M, N> m;
+
+  private:
+    // оценка текущего лабиринта: из кэша или is_solvable + pass_maze с записью в кэш
+    MazeScore evaluate(size_t &pass_maze_calls, size_t &cache_hits, size_t &cache_misses) {
+        MazeScore result;
+        if (score_cache) {
+            if (score_cache->find(mm.get_key(), result)) {
+                cache_hits++;
+                return result;
+            }
+            cache_misses++;
+        }
+        result.solvable = is_solvable<M, N>(m);
+        if (result.solvable) {
+            result.score = pass_maze<M, N>(m);
+            clean_maze<M, N>(m);
+            pass_maze_calls++;
+        }
+        if (score_cache) {
+            score_cache->insert(mm.get_key(), result);
+        }
+        return result;
+    }
+
+    MutationManager<M, N> mm;
+    ScoreCache *score_cache = nullptr;
+    size_t score = 0;
+    bool warmed_up = false;
+};
+
+} // namespace utils
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <vector>
+
+#include "maze_utils.hpp"
+
+namespace utils {
+
+// Локальный вход сети для позиции (i, j): стенки в окне 9x9 без центрального квадрата 3x3, 72 бита,
+// клетки за границей лабиринта считаются стенами. Та же раскладка, что и в get_dataset_from_maze.
+template <crd M, crd N>
+std::bitset<72> local_pattern(maze<M, N> m, int i, int j) {
+    std::bitset<72> input;
+    size_t index = 0;
+    for (int x = i - 4; x < i + 5; x++) {
+        for (int y = j - 4; y < j + 5; y++) {
+            if (x >= i - 1 && x <= i + 1 && y >= j - 1 && y <= j + 1) {
+                continue;
+            }
+            input[index++] = (x < 0 || x > M - 1 || y < 0 || y > N - 1) ? 1 : m[x][y] >= MX;
+        }
+    }
+    return input;
+}
+
+// Входные плоскости ConvNet для лабиринта, те же, что первые две плоскости get_sample: стенки (1 - стена)
+// и число посещений клеток за pass_maze, делённое на максимальное. planes - 2 * M * N чисел.
+template <crd M, crd N>
+void maze_planes(maze<M, N> m, float *planes) {
+    maze<M, N> local;
+    std::copy(&m[0][0], &m[0][0] + M * N, &local[0][0]);
+    clean_maze<M, N>(local);
+    pass_maze<M, N>(local);
+    size_t max_steps = 0;
+    for (int i = 0; i < M; i++) {
+        for (int j = 0; j < N; j++) {
+            if (local[i][j] < MX) {
+                max_steps = std::max(max_steps, local[i][j]);
+            }
+        }
+    }
+    for (int i = 0; i < M; i++) {
+        for (int j = 0; j < N; j++) {
+            bool wall = local[i][j] >= MX;
+            planes[i * N + j] = wall ? 1.f : 0.f;
+            planes[M * N + i * N + j] = wall ? 0.f : static_cast<float>(local[i][j]) / max_steps;
+        }
+    }
+}
+
+// внутренние позиции: центры квадрата 3x3, не задевающего рамку, i в [2, M - 3], j в [2, N - 3]
+template <crd M, crd N>
+constexpr size_t interior_positions = size_t(M - 4) * size_t(N - 4);
+
+// Оценка сетью всех внутренних позиций лабиринта одним батчем. Буферы входов, выходов и рабочая область сети
+// переиспользуются между вызовами, поэтому в поиске на один лабиринт не приходится ни одного выделения памяти.
+// Net - NeuralNetwork<72, ..., 9, ...>.
+template <typename Net, crd M, crd N>
+class MazeScorer {
+  public:
+    using Scalar = typename Net::ScalarType;
+
+    MazeScorer() : inputs(interior_positions<M, N>), probabilities(interior_positions<M, N> * 9) {}
+
+    // возвращает interior_positions x 9 вероятностей, строки в порядке обхода (i, j) по строкам
+    const Scalar *apply(const Net &net, maze<M, N> m) {
+        size_t k = 0;
+        for (int i = 2; i < M - 2; i++) {
+            for (int j = 2; j < N - 2; j++) {
+                inputs[k++] = local_pattern<M, N>(m, i, j);
+            }
+        }
+        net.ApplyBatch(inputs.data(), inputs.size(), probabilities.data(), ws);
+        return probabilities.data();
+    }
+
+    // вероятность стены в клетке k (0..8, по строкам) квадрата с центром (i, j) после последнего apply
+    Scalar probability(int i, int j, size_t k) const { return probabilities[index(i, j) * 9 + k]; }
+
+    static size_t index(int i, int j) { return size_t(i - 2) * (N - 4) + size_t(j - 2); }
+
+  private:
+    std::vector<std::bitset<72>> inputs;
+    std::vector<Scalar> probabilities;
+    typename Net::BatchWorkspace ws;
+};
+
+} // namespace utils
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <bitset>
 #include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include <limits>
 #include <queue>
@@ -294,6 +296,43 @@ size_t get_median(maze<M, N> m) {
     return v[v.size() / 2];
 }
 
+// Случайные 64-битные числа ключа Zobrist, по одному на клетку. Зерно фиксированное, поэтому ключ одного
+// и того же лабиринта совпадает во всех потоках и запусках и его можно класть в общий кэш.
+template <crd M, crd N>
+const std::array<std::array<uint64_t, N>, M> &zobrist_table() {
+    static const auto table = [] {
+        std::array<std::array<uint64_t, N>, M> t;
+        uint64_t state = 0x5A0B215A0B215A0BULL;
+        for (auto &row : t) {
+            for (auto &value : row) { // splitmix64
+                uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                value = z ^ (z >> 31);
+            }
+        }
+        return t;
+    }();
+    return table;
+}
+
+// Ключ Zobrist расположения стен: xor чисел zobrist_table по стенам внутри рамки (клетки, что и в
+// maze_to_bitset). Считается за M*N; при мутациях его ведут инкрементально Mutation::apply и increment_maze.
+template <crd M, crd N>
+uint64_t zobrist_key(maze<M, N> m) {
+    const auto &table = zobrist_table<M, N>();
+    uint64_t key = 0;
+    for (crd i = 1; i < M - 1; i++) {
+        for (crd j = 1; j < N - 1; j++) {
+            if ((i == 1 && j == 1) || (i == M - 2 && j == N - 2)) {
+                continue;
+            }
+            key ^= m[i][j] >= MX ? table[i][j] : 0;
+        }
+    }
+    return key;
+}
+
 template <size_t C, crd M, crd N>
 struct Mutation {
     point points[C];
@@ -314,8 +353,15 @@ struct Mutation {
         }
     }
     void apply(maze<M, N> m) {
+        uint64_t key = 0;
+        apply(m, key);
+    }
+    // то же с обновлением ключа Zobrist; мутация - инверсия клеток, поэтому повторный вызов откатывает и ключ
+    void apply(maze<M, N> m, uint64_t &key) {
+        const auto &table = zobrist_table<M, N>();
         for (size_t i = 0; i < C; i++) {
             m[points[i].y][points[i].x] = m[points[i].y][points[i].x] >= MX ? 0 : MX;
+            key ^= table[points[i].y][points[i].x];
         }
     }
 };
@@ -389,6 +435,26 @@ void increment_maze(maze<M, N> &m) {
     }
 }
 
+// increment_maze с обновлением ключа Zobrist: в среднем меняются две клетки
+template <crd M, crd N>
+void increment_maze(maze<M, N> &m, uint64_t &key) {
+    const auto &table = zobrist_table<M, N>();
+    for (crd i = 1; i < M - 1; i++) {
+        for (crd j = 1; j < N - 1; j++) {
+            if (i == 1 && j == 1)
+                continue;
+            if (i == M - 2 && j == N - 2)
+                continue;
+            key ^= table[i][j];
+            if (m[i][j] < MX) {
+                m[i][j] = MX;
+                return;
+            }
+            m[i][j] = 0;
+        }
+    }
+}
+
 template <crd M, crd N>
 void copy_maze(maze<M, N> &source, maze<M, N> &dist) {
     for (crd i = 0; i < M; i++) {
@@ -414,8 +480,13 @@ template <crd M, crd N>
 class MutationManager {
     std::tuple<Mutation<1, M, N>, Mutation<2, M, N>, Mutation<3, M, N>, Mutation<4, M, N>, Mutation<5, M, N>> mutations;
     size_t last_mutation = 0;
+    uint64_t key = 0; // ключ Zobrist лабиринта, который меняется только через этот менеджер
 
   public:
+    // пересчитать ключ с нуля, когда лабиринт менялся в обход менеджера
+    void reset_key(maze<M, N> m) { key = zobrist_key<M, N>(m); }
+    uint64_t get_key() const { return key; }
+
     void randomize_mutation(size_t i) {
         switch (i) {
         case 0:
@@ -441,19 +512,19 @@ class MutationManager {
     void apply_mutation(maze<M, N> m, size_t i) {
         switch (i) {
         case 0:
-            std::get<0>(mutations).apply(m);
+            std::get<0>(mutations).apply(m, key);
             break;
         case 1:
-            std::get<1>(mutations).apply(m);
+            std::get<1>(mutations).apply(m, key);
             break;
         case 2:
-            std::get<2>(mutations).apply(m);
+            std::get<2>(mutations).apply(m, key);
             break;
         case 3:
-            std::get<3>(mutations).apply(m);
+            std::get<3>(mutations).apply(m, key);
             break;
         case 4:
-            std::get<4>(mutations).apply(m);
+            std::get<4>(mutations).apply(m, key);
             break;
         default:
             throw std::runtime_error("Invalid mutation index");
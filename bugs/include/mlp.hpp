@@ -0,0 +1,242 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "dataset.hpp"
+#include "nn.hpp"
+#include "nn_kernels.hpp"
+#include "train_metrics.hpp"
+
+// Полносвязная сеть с формой, заданной во время выполнения, для float-сэмплов генератора (DS, DatasetView):
+// 1953 входа get_sample не помещаются ни в bitset, ни в std::array на стеке, как у NeuralNetwork.
+// Все веса и смещения лежат в одном выровненном буфере на куче, строки весов дополнены нулями до кэш-линии.
+// Буферы активаций и ошибок выделяются один раз в конструкторе и переиспользуются для каждого сэмпла.
+// Скрытые слои с активацией AF, выходной - сигмоида, ошибка и шаг SGD с L2 такие же, как в NeuralNetwork.
+class MLP {
+  public:
+    // sizes - размеры слоёв от входа к выходу, минимум два
+    explicit MLP(const std::vector<std::size_t> &sizes, ActivationFunction af = ActivationFunction::Sigmoid,
+                 unsigned seed = std::random_device()())
+        : af(af), gen(seed) {
+        assert(sizes.size() >= 2);
+        std::size_t offset = 0;
+        for (std::size_t l = 0; l + 1 < sizes.size(); ++l) {
+            Layer layer;
+            layer.in = sizes[l];
+            layer.out = sizes[l + 1];
+            layer.stride = nn_kernels::padded<float>(layer.in);
+            layer.weights = offset;
+            offset += layer.out * layer.stride;
+            layer.bias = offset;
+            offset += nn_kernels::padded<float>(layer.out);
+            layers.push_back(layer);
+        }
+        params.assign(offset, 0.f);
+
+        for (std::size_t size : sizes) {
+            activations.emplace_back(nn_kernels::padded<float>(size), 0.f);
+            errors.emplace_back(nn_kernels::padded<float>(size), 0.f);
+        }
+        target.resize(output_size());
+
+        // при тысячах входов равномерное [-1, 1], как у NeuralNetwork, насыщает сигмоиду, поэтому Glorot
+        std::mt19937 gen(seed);
+        for (const auto &layer : layers) {
+            float limit = std::sqrt(6.f / float(layer.in + layer.out));
+            std::uniform_real_distribution<float> dist(-limit, limit);
+            for (std::size_t i = 0; i < layer.out; ++i) {
+                float *row = weights(layer, i);
+                for (std::size_t j = 0; j < layer.in; ++j) {
+                    row[j] = dist(gen);
+                }
+            }
+        }
+    }
+
+    std::size_t input_size() const { return layers.front().in; }
+    std::size_t output_size() const { return layers.back().out; }
+    std::size_t num_parameters() const { return params.size(); }
+
+    // Прямой проход, input - input_size() чисел. Возвращает выходы сигмоиды, указатель действителен
+    // до следующего вызова.
+    const float *Forward(const float *input) {
+        std::copy(input, input + input_size(), activations[0].begin());
+        return ForwardFromInputBuffer();
+    }
+
+    // Один шаг SGD по сэмплу, возвращает квадратичную ошибку
+    double TrainSample(const float *input, const float *target_values, double learning_rate, double l2_lambda) {
+        Forward(input);
+        return BackwardFromOutputs(target_values, learning_rate, l2_lambda);
+    }
+
+    // on_epoch - метрики каждой эпохи, как TrainOptions::on_epoch у NeuralNetwork
+    double Train(const DS &dataset, double learning_rate, std::size_t epochs, double decay_rate, double l2_lambda,
+                 const EpochCallback &on_epoch = {}) {
+#ifndef NDEBUG
+        for (const auto &[input, output] : dataset.samples()) {
+            assert(input.size() == input_size() && output.size() == output_size());
+        }
+#endif
+        return TrainEpochs(dataset.size(), learning_rate, epochs, decay_rate, l2_lambda, on_epoch,
+                           [&](std::size_t k, double lr, double l2) {
+                               return TrainSample(dataset[k].first.data(), dataset[k].second.data(), lr, l2);
+                           });
+    }
+
+    // Обучение прямо по упакованному файлу: вход распаковывается сразу в буфер первого слоя
+    double Train(const DatasetView &view, double learning_rate, std::size_t epochs, double decay_rate,
+                 double l2_lambda, const EpochCallback &on_epoch = {}) {
+        assert(view.input_size() == input_size() && view.output_size() == output_size());
+        view.advise_random();
+        return TrainEpochs(view.size(), learning_rate, epochs, decay_rate, l2_lambda, on_epoch,
+                           [&](std::size_t k, double lr, double l2) {
+                               view.expand_input(k, activations[0].data());
+                               view.expand_output(k, target.data());
+                               ForwardFromInputBuffer();
+                               return BackwardFromOutputs(target.data(), lr, l2);
+                           });
+    }
+
+    // доля сэмплов, у которых все выходы после порога 0.5 совпали с целью
+    double Score(const DS &dataset) {
+        std::size_t correct = 0;
+        for (const auto &[input, output] : dataset.samples()) {
+            correct += Matches(Forward(input.data()), output.data());
+        }
+        return dataset.size() ? double(correct) / dataset.size() : 0.;
+    }
+
+    double Score(const DatasetView &view) {
+        std::size_t correct = 0;
+        for (std::size_t k = 0; k < view.size(); ++k) {
+            view.expand_input(k, activations[0].data());
+            view.expand_output(k, target.data());
+            correct += Matches(ForwardFromInputBuffer(), target.data());
+        }
+        return view.size() ? double(correct) / view.size() : 0.;
+    }
+
+  private:
+    // смещения в params: веса - out строк по stride, затем смещения
+    struct Layer {
+        std::size_t in = 0, out = 0, stride = 0;
+        std::size_t weights = 0, bias = 0;
+    };
+
+    float *weights(const Layer &layer, std::size_t row) { return params.data() + layer.weights + row * layer.stride; }
+    float *bias(const Layer &layer) { return params.data() + layer.bias; }
+
+    float Activate(float x) const {
+        return af == ActivationFunction::Sigmoid ? 1.f / (1.f + std::exp(-x)) : (x > 0 ? x : 0.01f * x);
+    }
+
+    float ActivateDerivative(float y) const {
+        return af == ActivationFunction::Sigmoid ? y * (1.f - y) : (y > 0 ? 1.f : 0.01f);
+    }
+
+    bool Matches(const float *output, const float *expected) const {
+        for (std::size_t i = 0; i < output_size(); ++i) {
+            if ((output[i] > 0.5f) != (expected[i] > 0.5f)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const float *ForwardFromInputBuffer() {
+        for (std::size_t l = 0; l < layers.size(); ++l) {
+            const Layer &layer = layers[l];
+            const float *in = activations[l].data();
+            float *out = activations[l + 1].data();
+            const float *b = bias(layer);
+            bool last = l + 1 == layers.size();
+            for (std::size_t i = 0; i < layer.out; ++i) {
+                float sum = b[i] + nn_kernels::dot(weights(layer, i), in, layer.stride);
+                out[i] = last ? 1.f / (1.f + std::exp(-sum)) : Activate(sum);
+            }
+        }
+        return activations.back().data();
+    }
+
+    // обратный проход по активациям последнего Forward и шаг SGD
+    double BackwardFromOutputs(const float *target_values, double learning_rate, double l2_lambda) {
+        const float *output = activations.back().data();
+        float *delta = errors.back().data();
+        double total_error = 0.0;
+        for (std::size_t i = 0; i < output_size(); ++i) {
+            float diff = target_values[i] - output[i];
+            delta[i] = diff * output[i] * (1.f - output[i]);
+            total_error += double(diff) * double(diff);
+        }
+
+        const float lr = float(learning_rate);
+        const float decay = float(1.0 - learning_rate * l2_lambda);
+        for (std::size_t l = layers.size(); l-- > 0;) {
+            const Layer &layer = layers[l];
+            delta = errors[l + 1].data();
+
+            // ошибка предыдущего слоя считается до обновления весов этого слоя; для входа она не нужна
+            if (l > 0) {
+                float *prev = errors[l].data();
+                std::fill(errors[l].begin(), errors[l].end(), 0.f);
+                for (std::size_t i = 0; i < layer.out; ++i) {
+                    nn_kernels::axpy(layer.stride, delta[i], weights(layer, i), prev);
+                }
+                const float *prev_out = activations[l].data();
+                for (std::size_t j = 0; j < layer.in; ++j) {
+                    prev[j] *= ActivateDerivative(prev_out[j]);
+                }
+            }
+
+            const float *in = activations[l].data();
+            float *b = bias(layer);
+            for (std::size_t i = 0; i < layer.out; ++i) {
+                nn_kernels::axpby(layer.stride, lr * delta[i], in, decay, weights(layer, i));
+                b[i] += lr * delta[i];
+            }
+        }
+        return total_error;
+    }
+
+    template <typename TrainOne>
+    double TrainEpochs(std::size_t count, double learning_rate, std::size_t epochs, double decay_rate,
+                       double l2_lambda, const EpochCallback &on_epoch, TrainOne &&train_one) {
+        double last_error = std::numeric_limits<double>::max();
+        // каждая эпоха идёт в своём случайном порядке; для DatasetView это произвольный доступ к записям файла
+        std::vector<std::size_t> order(count);
+        std::iota(order.begin(), order.end(), 0);
+        EpochTimer timer;
+        for (std::size_t epoch = 0; epoch < epochs; ++epoch) {
+            timer.begin();
+            double current_learning_rate = learning_rate * std::exp(-decay_rate * epoch);
+            double total_error = 0.0;
+            std::shuffle(order.begin(), order.end(), gen);
+            for (std::size_t k : order) {
+                total_error += train_one(k, current_learning_rate, l2_lambda);
+            }
+            last_error = total_error;
+            if (on_epoch) {
+                on_epoch(timer.finish(epoch, total_error, current_learning_rate, count));
+            }
+        }
+        return last_error;
+    }
+
+    ActivationFunction af;
+    std::vector<Layer> layers;
+    nn_kernels::aligned_vector<float> params;
+
+    // буферы одного сэмпла: activations[0] - вход, activations[l + 1] - выход слоя l; дополнение нулевое
+    std::vector<nn_kernels::aligned_vector<float>> activations;
+    std::vector<nn_kernels::aligned_vector<float>> errors;
+    std::vector<float> target;
+    std::mt19937 gen; // порядок сэмплов в эпохах, от seed конструктора
+};
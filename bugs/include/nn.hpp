@@ -1,187 +1,481 @@
+#pragma once
+
+#include <algorithm>
 #include <array>
+#include <bit>
 #include <bitset>
+#include <cassert>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <optional>
 #include <random>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "activations.hpp"
+#include "nn_file.hpp"
+#include "nn_kernels.hpp"
+#include "thread_pool.hpp"
+#include "train_metrics.hpp"
+
 // #include <omp.h>
 
-enum class ActivationFunction { Sigmoid, LeakyReLU };
+// Вызывает f(j) для каждого установленного бита: bitset читается 64-битными словами, биты перебираются через
+// countr_zero, а не по одному через operator[]
+template <std::size_t N, typename F>
+inline void ForEachSetBit(const std::bitset<N> &bits, F &&f) {
+    if constexpr (N <= 64) {
+        for (uint64_t word = bits.to_ullong(); word; word &= word - 1) {
+            f(std::size_t(std::countr_zero(word)));
+        }
+    } else {
+        const std::bitset<N> mask(~0ULL);
+        for (std::size_t base = 0; base < N; base += 64) {
+            for (uint64_t word = ((bits >> base) & mask).to_ullong(); word; word &= word - 1) {
+                f(base + std::size_t(std::countr_zero(word)));
+            }
+        }
+    }
+}
+
+enum class Optimizer { SGD, Momentum, Adam };
+
+// Параметры обучения NeuralNetwork::Train сверх скорости, числа эпох, затухания и L2
+struct TrainOptions {
+    std::size_t batch_size = 1; // 1 - по одному сэмплу, больше - мини-батчи
+    ThreadPool *pool = nullptr; // с пулом батч делится между потоками
+    bool hogwild = false;       // потоки пула обучают свои батчи без синхронизации
 
+    Optimizer optimizer = Optimizer::SGD;
+    double momentum = 0.9;                             // Momentum
+    double beta1 = 0.9, beta2 = 0.999, epsilon = 1e-8; // Adam
+
+    // доля датасета под валидацию (0 - без неё); с валидацией обучение останавливается после patience эпох
+    // без улучшения ошибки на ней, и в конце восстанавливаются веса лучшей эпохи
+    double validation_fraction = 0;
+    std::size_t patience = 10;
+    unsigned split_seed = 0; // перемешивание перед разбиением
+
+    EpochCallback on_epoch; // метрики каждой эпохи (ConsoleSink, CsvSink); пустой - без вывода
+};
+
+struct TrainResult {
+    double train_error = 0;      // на последней эпохе
+    double validation_error = 0; // лучшая, если была валидация
+    std::size_t best_epoch = 0;
+    std::size_t epochs = 0; // сколько эпох выполнено
+};
+
+// Scalar - тип весов и активаций (double или float). Строки весов длины HiddenNeurons дополнены нулями до
+// HiddenStride и выровнены по кэш-линии, поэтому плотные слои считаются векторными ядрами nn_kernels
+// без хвостов. Нули в дополнении сохраняются при обучении: им соответствуют нулевые активации и ошибки.
+// SigmoidPolicy - способ вычисления сигмоиды (ExactSigmoid, TableSigmoid, RationalSigmoid из activations.hpp).
 template <std::size_t InputNeurons, std::size_t HiddenLayers, std::size_t HiddenNeurons, std::size_t OutputNeurons,
-          ActivationFunction AF>
+          ActivationFunction AF, typename Scalar = double, typename SigmoidPolicy = ExactSigmoid>
 class NeuralNetwork {
   public:
-    NeuralNetwork() : gen(rd()), dist(-1, 1) { InitializeWeights(); }
-
-    NeuralNetwork(const NeuralNetwork<InputNeurons, HiddenLayers, HiddenNeurons, OutputNeurons, AF> &other)
-        : gen(rd()), dist(-1, 1) {
-        for (std::size_t i = 0; i < HiddenNeurons; ++i) {
-            for (std::size_t j = 0; j < InputNeurons; ++j) {
-                weights_input_hidden_[i][j] = other.weights_input_hidden_[i][j];
-            }
+    static constexpr std::size_t Inputs = InputNeurons, Layers = HiddenLayers, Hidden = HiddenNeurons,
+                                 Outputs = OutputNeurons;
+    static constexpr std::size_t HiddenStride = nn_kernels::padded<Scalar>(HiddenNeurons);
+
+    using ScalarType = Scalar;
+    using Sample = std::pair<std::bitset<InputNeurons>, std::bitset<OutputNeurons>>;
+    using Row = std::array<Scalar, HiddenStride>;
+
+    // Все параметры лежат в одном выровненном буфере params_ блоками по слоям, в раскладке файла nn_file:
+    // веса первого слоя по входам, затем скрытых слоёв, выходного, смещения скрытых и выходного.
+    // Каждый блок - целое число кэш-линий.
+    static constexpr std::size_t InputHiddenOffset = 0;
+    static constexpr std::size_t HiddenHiddenOffset = InputNeurons * HiddenStride;
+    static constexpr std::size_t HiddenOutputOffset =
+        HiddenHiddenOffset + (HiddenLayers - 1) * HiddenNeurons * HiddenStride;
+    static constexpr std::size_t BiasHiddenOffset = HiddenOutputOffset + OutputNeurons * HiddenStride;
+    static constexpr std::size_t BiasOutputOffset = BiasHiddenOffset + HiddenStride;
+    static constexpr std::size_t ParameterCount = BiasOutputOffset + nn_kernels::padded<Scalar>(OutputNeurons);
+
+    // Градиенты по всем параметрам, плоско и в раскладке params_ (те же смещения блоков)
+    struct Gradients {
+        nn_kernels::aligned_vector<Scalar> values = nn_kernels::aligned_vector<Scalar>(ParameterCount);
+
+        Scalar *block(std::size_t offset) { return values.data() + offset; }
+
+        void clear() { std::fill(values.begin(), values.end(), Scalar(0)); }
+
+        void add(const Gradients &other) {
+            nn_kernels::axpy(values.size(), Scalar(1), other.values.data(), values.data());
         }
-
-        for (std::size_t h = 0; h < HiddenLayers - 1; ++h) {
-            for (std::size_t i = 0; i < HiddenNeurons; ++i) {
-                for (std::size_t j = 0; j < HiddenNeurons; ++j) {
-                    weights_hidden_hidden_[h][i][j] = other.weights_hidden_hidden_[h][i][j];
-                }
-            }
+    };
+
+    // Буферы батча: строки - сэмплы. Переиспользуются между вызовами, растут только при увеличении батча.
+    // Строки скрытых слоёв имеют длину HiddenStride, дополнение всегда нулевое.
+    struct BatchWorkspace {
+        std::vector<Scalar> input;   // batch x InputNeurons
+        std::vector<Scalar> hidden;  // HiddenLayers x batch x HiddenStride, активации
+        std::vector<Scalar> output;  // batch x OutputNeurons
+        std::vector<Scalar> hidden_error;
+        std::vector<Scalar> output_error;
+
+        void resize(std::size_t batch) {
+            input.resize(batch * InputNeurons);
+            hidden.resize(HiddenLayers * batch * HiddenStride);
+            output.resize(batch * OutputNeurons);
+            hidden_error.resize(HiddenLayers * batch * HiddenStride);
+            output_error.resize(batch * OutputNeurons);
         }
-
-        for (std::size_t i = 0; i < OutputNeurons; ++i) {
-            for (std::size_t j = 0; j < HiddenNeurons; ++j) {
-                weights_hidden_output_[i][j] = other.weights_hidden_output_[i][j];
+    };
+
+    // Состояние оптимизатора в той же раскладке, что и веса, и число шагов для поправки Adam на смещение
+    struct OptimizerState {
+        nn_kernels::aligned_vector<Scalar> first_moment;  // скорость Momentum, первый момент Adam
+        nn_kernels::aligned_vector<Scalar> second_moment; // второй момент Adam
+        std::size_t step = 0;
+
+        // память выделяется до обучения, а не в ApplyGradients: там она гонялась бы в hogwild
+        void prepare(Optimizer optimizer) {
+            if (optimizer != Optimizer::SGD && first_moment.empty()) {
+                first_moment.assign(ParameterCount, Scalar(0));
+            }
+            if (optimizer == Optimizer::Adam && second_moment.empty()) {
+                second_moment.assign(ParameterCount, Scalar(0));
             }
         }
 
-        for (std::size_t i = 0; i < HiddenNeurons; ++i) {
-            bias_hidden_[i] = other.bias_hidden_[i];
+        void reset() {
+            std::fill(first_moment.begin(), first_moment.end(), Scalar(0));
+            std::fill(second_moment.begin(), second_moment.end(), Scalar(0));
+            step = 0;
         }
+    };
 
-        for (std::size_t i = 0; i < OutputNeurons; ++i) {
-            bias_output_[i] = other.bias_output_[i];
-        }
+    NeuralNetwork() : NeuralNetwork(std::random_device()()) {}
+
+    explicit NeuralNetwork(unsigned seed) : params_(ParameterCount, Scalar(0)) {
+        BindViews(params_.data());
+        InitializeWeights(seed);
     }
 
-    void operator=(const NeuralNetwork<InputNeurons, HiddenLayers, HiddenNeurons, OutputNeurons, AF> &other) {
-        for (std::size_t i = 0; i < HiddenNeurons; ++i) {
-            for (std::size_t j = 0; j < InputNeurons; ++j) {
-                weights_input_hidden_[i][j] = other.weights_input_hidden_[i][j];
-            }
-        }
+    // копируются только параметры, одним memcpy; состояние оптимизатора и буферы у копии свои.
+    // Копия сети, загруженной map_binary, получает собственный буфер.
+    NeuralNetwork(const NeuralNetwork &other) : params_(other.weights_, other.weights_ + ParameterCount) {
+        BindViews(params_.data());
+    }
 
-        for (std::size_t h = 0; h < HiddenLayers - 1; ++h) {
-            for (std::size_t i = 0; i < HiddenNeurons; ++i) {
-                for (std::size_t j = 0; j < HiddenNeurons; ++j) {
-                    weights_hidden_hidden_[h][i][j] = other.weights_hidden_hidden_[h][i][j];
-                }
-            }
+    // буфер может быть пустым после перемещения, поэтому присваивается целиком и представления перепривязываются
+    NeuralNetwork &operator=(const NeuralNetwork &other) {
+        if (this != &other) {
+            params_.assign(other.weights_, other.weights_ + ParameterCount);
+            mapped_.reset();
+            BindViews(params_.data());
         }
+        return *this;
+    }
 
-        for (std::size_t i = 0; i < OutputNeurons; ++i) {
-            for (std::size_t j = 0; j < HiddenNeurons; ++j) {
-                weights_hidden_output_[i][j] = other.weights_hidden_output_[i][j];
+    // Буфер или отображение переходит к *this, представления привязываются заново; у исходной сети они
+    // обнуляются, иначе указывали бы в чужую память. Исходную сеть можно только присвоить или удалить.
+    NeuralNetwork(NeuralNetwork &&other) noexcept { *this = std::move(other); }
+
+    NeuralNetwork &operator=(NeuralNetwork &&other) noexcept {
+        if (this != &other) {
+            Scalar *weights = other.weights_;
+            params_ = std::move(other.params_);
+            mapped_ = std::move(other.mapped_);
+            options_ = std::move(other.options_);
+            optimizer_state_ = std::move(other.optimizer_state_);
+            shard_optimizer_ = std::move(other.shard_optimizer_);
+            batch_grad_ = std::move(other.batch_grad_);
+            batch_ws_ = std::move(other.batch_ws_);
+            shard_grad_ = std::move(other.shard_grad_);
+            shard_ws_ = std::move(other.shard_ws_);
+            if (weights) {
+                BindViews(mapped_ ? weights : params_.data());
+            } else {
+                UnbindViews();
             }
+            other.UnbindViews();
         }
+        return *this;
+    }
 
-        for (std::size_t i = 0; i < HiddenNeurons; ++i) {
-            bias_hidden_[i] = other.bias_hidden_[i];
-        }
+    Scalar *parameters() { return weights_; }
+    const Scalar *parameters() const { return weights_; }
 
-        for (std::size_t i = 0; i < OutputNeurons; ++i) {
-            bias_output_[i] = other.bias_output_[i];
-        }
+    // batch_size = 1 - обычный SGD по одному сэмплу, больше - мини-батчи с усреднением градиента по батчу.
+    // С пулом потоков каждый батч делится между потоками (синхронно), либо при hogwild потоки обучают
+    // свои батчи и без блокировок пишут в общие веса.
+    double Train(const std::vector<std::pair<std::bitset<InputNeurons>, std::bitset<OutputNeurons>>> &dataset,
+               double learning_rate, std::size_t epochs, double decay_rate, double l2_lambda,
+               std::size_t batch_size = 1, ThreadPool *pool = nullptr, bool hogwild = false) {
+        TrainOptions options;
+        options.batch_size = batch_size;
+        options.pool = pool;
+        options.hogwild = hogwild;
+        return Train(dataset, learning_rate, epochs, decay_rate, l2_lambda, options).train_error;
     }
 
-    double Train(const std::vector<std::pair<std::bitset<InputNeurons>, std::bitset<OutputNeurons>>> &dataset,
-               double learning_rate, std::size_t epochs, double decay_rate, double l2_lambda) {
-                double last_error = std::numeric_limits<double>::max();
+    // Обучение с выбором оптимизатора и, при validation_fraction > 0, с ранней остановкой по валидации.
+    // Состояние оптимизатора хранится в сети и сбрасывается при смене оптимизатора.
+    TrainResult Train(const std::vector<std::pair<std::bitset<InputNeurons>, std::bitset<OutputNeurons>>> &dataset,
+                      double learning_rate, std::size_t epochs, double decay_rate, double l2_lambda,
+                      const TrainOptions &options) {
+        SetOptimizer(options);
+
+        using Sample = std::pair<std::bitset<InputNeurons>, std::bitset<OutputNeurons>>;
+        std::vector<Sample> split_train, validation;
+        const std::vector<Sample> *train = &dataset;
+        if (options.validation_fraction > 0) {
+            std::vector<std::size_t> order(dataset.size());
+            for (std::size_t k = 0; k < order.size(); ++k) {
+                order[k] = k;
+            }
+            std::shuffle(order.begin(), order.end(), std::mt19937(options.split_seed));
+            std::size_t validation_size = std::size_t(dataset.size() * options.validation_fraction);
+            for (std::size_t k = 0; k < order.size(); ++k) {
+                (k < validation_size ? validation : split_train).push_back(dataset[order[k]]);
+            }
+            train = &split_train;
+        }
+
+        TrainResult result;
+        result.train_error = std::numeric_limits<double>::max();
+        result.validation_error = std::numeric_limits<double>::max();
+        std::optional<NeuralNetwork> best;
+        std::size_t batch_size = std::max<std::size_t>(options.batch_size, 1);
+        ThreadPool *pool = options.pool;
+        EpochTimer timer;
         for (std::size_t epoch = 0; epoch < epochs; ++epoch) {
+            timer.begin();
             double total_error = 0.0;
 
             double current_learning_rate = learning_rate * std::exp(-decay_rate * epoch);
 
-            for (const auto &[input, target] : dataset) {
-                total_error += TrainIteration(input, target, current_learning_rate, l2_lambda);
+            if (pool && options.hogwild) {
+                total_error += TrainEpochHogwild(train->data(), train->size(), batch_size, current_learning_rate,
+                                                 l2_lambda, *pool);
+            } else if (pool && batch_size > 1) {
+                for (std::size_t begin = 0; begin < train->size(); begin += batch_size) {
+                    std::size_t count = std::min(batch_size, train->size() - begin);
+                    total_error +=
+                        TrainBatchParallel(train->data() + begin, count, current_learning_rate, l2_lambda, *pool);
+                }
+            } else if (batch_size == 1 && options_.optimizer == Optimizer::SGD) {
+                for (const auto &[input, target] : *train) {
+                    total_error += TrainIteration(input, target, current_learning_rate, l2_lambda);
+                }
+            } else {
+                for (std::size_t begin = 0; begin < train->size(); begin += batch_size) {
+                    std::size_t count = std::min(batch_size, train->size() - begin);
+                    total_error += TrainBatch(train->data() + begin, count, current_learning_rate, l2_lambda);
+                }
+            }
+            result.train_error = total_error;
+            result.epochs = epoch + 1;
+
+            double validation_error = validation.empty() ? 0.0 : Error(validation);
+            if (!validation.empty() && validation_error < result.validation_error) {
+                result.validation_error = validation_error;
+                result.best_epoch = epoch;
+                if (best) {
+                    *best = *this;
+                } else {
+                    best.emplace(*this);
+                }
             }
-            last_error = total_error;
-
-            bool print = (epoch < 10) || (epoch < 100 && epoch % 10 == 0) || (epoch < 1000 && epoch % 100 == 0) ||
-                         (epoch % 1000 == 0);
 
-            if (print) {
-                std::cout << "Epoch " << epoch << ": error = " << total_error
-                          << ", learning rate = " << current_learning_rate << std::endl;
+            if (options.on_epoch) {
+                EpochMetrics metrics = timer.finish(epoch, total_error, current_learning_rate, train->size());
+                metrics.validation_error = validation_error;
+                options.on_epoch(metrics);
             }
 
-            if (total_error < 1e-3) {
-                std::cout << "Converged at epoch " << epoch << std::endl;
+            // сошлось или ранняя остановка; номер эпохи виден в result
+            if (total_error < 1e-3 || (!validation.empty() && epoch - result.best_epoch >= options.patience)) {
                 break;
             }
         }
-        return last_error;
+        if (best) {
+            *this = *best;
+        }
+        return result;
+    }
+
+    // суммарная квадратичная ошибка выходов на датасете, как в TrainIteration, но без обучения
+    double Error(const std::vector<std::pair<std::bitset<InputNeurons>, std::bitset<OutputNeurons>>> &dataset) const {
+        constexpr std::size_t batch = 256;
+        BatchWorkspace ws;
+        std::vector<std::bitset<InputNeurons>> inputs(batch);
+        std::vector<Scalar> probabilities(batch * OutputNeurons);
+        double total_error = 0.0;
+        for (std::size_t begin = 0; begin < dataset.size(); begin += batch) {
+            std::size_t count = std::min(batch, dataset.size() - begin);
+            for (std::size_t b = 0; b < count; ++b) {
+                inputs[b] = dataset[begin + b].first;
+            }
+            ApplyBatch(inputs.data(), count, probabilities.data(), ws);
+            for (std::size_t b = 0; b < count; ++b) {
+                for (std::size_t i = 0; i < OutputNeurons; ++i) {
+                    double diff = double(dataset[begin + b].second[i]) - double(probabilities[b * OutputNeurons + i]);
+                    total_error += diff * diff;
+                }
+            }
+        }
+        return total_error;
+    }
+
+    // Выбор оптимизатора для TrainBatch и ApplyGradients; накопленные моменты сбрасываются при его смене
+    void SetOptimizer(const TrainOptions &options) {
+        if (options.optimizer != options_.optimizer) {
+            optimizer_state_ = OptimizerState();
+            shard_optimizer_.clear();
+        }
+        options_ = options;
+        optimizer_state_.prepare(options.optimizer);
+    }
+
+    // обнуление моментов, например после замены весов копией другой сети
+    void ResetOptimizerState() {
+        optimizer_state_.reset();
+        for (auto &state : shard_optimizer_) {
+            state.reset();
+        }
     }
 
     std::bitset<OutputNeurons> Apply(const std::bitset<InputNeurons> &input) const {
-        std::array<double, HiddenNeurons> hidden_input{};
-        std::array<std::array<double, HiddenNeurons>, HiddenLayers> hidden_outputs{};
-        std::array<double, OutputNeurons> output_input{};
+        alignas(nn_kernels::alignment) Row hidden_input{};
+        alignas(nn_kernels::alignment) std::array<Row, HiddenLayers> hidden_outputs{};
         std::bitset<OutputNeurons> output;
 
         // Input layer -> first hidden layer
+        InputLayer(input, hidden_input);
         for (std::size_t i = 0; i < HiddenNeurons; ++i) {
-            for (std::size_t j = 0; j < InputNeurons; ++j) {
-                hidden_input[i] += input[j] * weights_input_hidden_[i][j];
-            }
-            hidden_input[i] += bias_hidden_[i];
-            if constexpr (AF == ActivationFunction::Sigmoid) {
-                hidden_outputs[0][i] = Sigmoid(hidden_input[i]);
-            } else {
-                hidden_outputs[0][i] = LeakyReLU(hidden_input[i]);
-            }
+            hidden_outputs[0][i] = Activate(hidden_input[i]);
         }
 
         // Hidden layers
         for (std::size_t h = 1; h < HiddenLayers; ++h) {
-            std::fill(hidden_input.begin(), hidden_input.end(), 0.0);
             for (std::size_t i = 0; i < HiddenNeurons; ++i) {
-                for (std::size_t j = 0; j < HiddenNeurons; ++j) {
-                    hidden_input[i] += hidden_outputs[h - 1][j] * weights_hidden_hidden_[h - 1][i][j];
-                }
-                hidden_input[i] += bias_hidden_[i];
-                if constexpr (AF == ActivationFunction::Sigmoid) {
-                    hidden_outputs[h][i] = Sigmoid(hidden_input[i]);
-                } else {
-                    hidden_outputs[h][i] = LeakyReLU(hidden_input[i]);
-                }
+                hidden_outputs[h][i] = Activate(bias_hidden_[i] + nn_kernels::dot(weights_hidden_hidden_[h - 1][i].data(),
+                                                                                  hidden_outputs[h - 1].data(),
+                                                                                  HiddenStride));
             }
         }
 
         // Last hidden layer -> output layer
         for (std::size_t i = 0; i < OutputNeurons; ++i) {
-            for (std::size_t j = 0; j < HiddenNeurons; ++j) {
-                output_input[i] += hidden_outputs[HiddenLayers - 1][j] * weights_hidden_output_[i][j];
-            }
-            output_input[i] += bias_output_[i];
-            output[i] = (Sigmoid(output_input[i]) > 0.5);
+            Scalar output_input = bias_output_[i] + nn_kernels::dot(weights_hidden_output_[i].data(),
+                                                                    hidden_outputs[HiddenLayers - 1].data(),
+                                                                    HiddenStride);
+            output[i] = (Sigmoid(output_input) > Scalar(0.5));
         }
 
         return output;
     }
 
     double Score(const std::vector<std::pair<std::bitset<InputNeurons>, std::bitset<OutputNeurons>>> &dataset) const {
+        constexpr std::size_t batch = 256;
+        BatchWorkspace ws;
+        std::vector<std::bitset<InputNeurons>> inputs(batch);
+        std::vector<Scalar> probabilities(batch * OutputNeurons);
         double correct = 0.0;
-        for (const auto &[input, target] : dataset) {
-            std::bitset<OutputNeurons> output = Apply(input);
-            if (output == target) {
-                ++correct;
+        for (std::size_t begin = 0; begin < dataset.size(); begin += batch) {
+            std::size_t count = std::min(batch, dataset.size() - begin);
+            for (std::size_t b = 0; b < count; ++b) {
+                inputs[b] = dataset[begin + b].first;
+            }
+            ApplyBatch(inputs.data(), count, probabilities.data(), ws);
+            for (std::size_t b = 0; b < count; ++b) {
+                bool same = true;
+                for (std::size_t i = 0; i < OutputNeurons; ++i) {
+                    same &= (probabilities[b * OutputNeurons + i] > Scalar(0.5)) == dataset[begin + b].second[i];
+                }
+                correct += same;
             }
         }
         return correct / dataset.size();
     }
 
+    // Прямой проход по батчу из count входов подряд произведениями матриц. В probabilities пишутся выходы сигмоиды,
+    // count x OutputNeurons построчно. ws переиспользуется между вызовами, сама сеть не меняется, поэтому
+    // из разных потоков можно вызывать одновременно, каждый со своим ws.
+    void ApplyBatch(const std::bitset<InputNeurons> *inputs, std::size_t count, Scalar *probabilities,
+                    BatchWorkspace &ws) const {
+        ForwardBatch(count, ws, [&](std::size_t b) -> const std::bitset<InputNeurons> & { return inputs[b]; });
+        for (std::size_t b = 0; b < count; ++b) {
+            for (std::size_t i = 0; i < OutputNeurons; ++i) {
+                probabilities[b * OutputNeurons + i] =
+                    Sigmoid(ws.output[b * OutputNeurons + i] + bias_output_[i]);
+            }
+        }
+    }
+
   public:
-    static double Sigmoid(double x) { return 1.0 / (1.0 + std::exp(-x)); }
+    // Первый слой для бинарного входа: смещение плюс сумма столбцов весов установленных битов
+    void InputLayer(const std::bitset<InputNeurons> &input, Row &out) const {
+        std::copy(bias_hidden_.begin(), bias_hidden_.end(), out.begin());
+        ForEachSetBit(input, [&](std::size_t j) {
+            nn_kernels::axpy(HiddenStride, Scalar(1), weights_input_hidden_[j].data(), out.data());
+        });
+    }
 
-    static double SigmoidDerivative(double x) { return x * (1.0 - x); }
+    // активация по строкам батча rows x HiddenStride, на входе - сумма без смещения
+    void ActivateRows(Scalar *values, std::size_t rows) const {
+        for (std::size_t b = 0; b < rows; ++b) {
+            Scalar *row = values + b * HiddenStride;
+            for (std::size_t i = 0; i < HiddenNeurons; ++i) {
+                row[i] = Activate(row[i] + bias_hidden_[i]);
+            }
+        }
+    }
 
-    static double LeakyReLU(double x) { return x > 0 ? x : 0.01 * x; }
+    // умножение ошибок на производную активации по её выходу
+    static void DeriveRows(Scalar *errors, const Scalar *outputs, std::size_t rows) {
+        for (std::size_t k = 0; k < rows * HiddenStride; ++k) {
+            errors[k] *= ActivateDerivative(outputs[k]);
+        }
+    }
 
-    static double LeakyReLUDerivative(double x) { return x > 0 ? 1 : 0.01; }
+    static Scalar Activate(Scalar x) {
+        if constexpr (AF == ActivationFunction::Sigmoid) {
+            return Sigmoid(x);
+        } else {
+            return LeakyReLU(x);
+        }
+    }
+
+    // производная по выходу активации
+    static Scalar ActivateDerivative(Scalar y) {
+        if constexpr (AF == ActivationFunction::Sigmoid) {
+            return SigmoidDerivative(y);
+        } else {
+            return LeakyReLUDerivative(y);
+        }
+    }
+
+    static Scalar Sigmoid(Scalar x) { return SigmoidPolicy::apply(x); }
+
+    static Scalar SigmoidDerivative(Scalar x) { return x * (Scalar(1) - x); }
+
+    static Scalar LeakyReLU(Scalar x) { return x > 0 ? x : Scalar(0.01) * x; }
 
-    void InitializeWeights() {
+    static Scalar LeakyReLUDerivative(Scalar x) { return x > 0 ? Scalar(1) : Scalar(0.01); }
+
+    void InitializeWeights(unsigned seed) {
+        std::mt19937 gen(seed);
+        std::uniform_real_distribution<double> dist(-1, 1);
 
         // std::uniform_real_distribution<double> dist_input_hidden(-std::sqrt(6.0 / (InputNeurons + HiddenNeurons)),
         //                                                          std::sqrt(6.0 / (InputNeurons + HiddenNeurons)));
 
         for (std::size_t i = 0; i < HiddenNeurons; ++i) {
             for (std::size_t j = 0; j < InputNeurons; ++j) {
-                weights_input_hidden_[i][j] = dist(gen);
+                weights_input_hidden_[j][i] = Scalar(dist(gen));
             }
         }
         // std::uniform_real_distribution<double> dist_hidden_hidden(-std::sqrt(6.0 / (HiddenNeurons + HiddenNeurons)),
@@ -189,7 +483,7 @@ class NeuralNetwork {
         for (std::size_t h = 0; h < HiddenLayers - 1; ++h) {
             for (std::size_t i = 0; i < HiddenNeurons; ++i) {
                 for (std::size_t j = 0; j < HiddenNeurons; ++j) {
-                    weights_hidden_hidden_[h][i][j] = dist(gen);
+                    weights_hidden_hidden_[h][i][j] = Scalar(dist(gen));
                 }
             }
         }
@@ -199,146 +493,345 @@ class NeuralNetwork {
 
         for (std::size_t i = 0; i < OutputNeurons; ++i) {
             for (std::size_t j = 0; j < HiddenNeurons; ++j) {
-                weights_hidden_output_[i][j] = dist(gen);
+                weights_hidden_output_[i][j] = Scalar(dist(gen));
             }
         }
 
-        for (std::size_t i = 0; i < HiddenNeurons; ++i) {
-            bias_hidden_[i] = 0;
-        }
-
-        for (std::size_t i = 0; i < OutputNeurons; ++i) {
-            bias_output_[i] = 0;
-        }
+        std::fill(bias_hidden_.begin(), bias_hidden_.end(), Scalar(0));
+        std::fill(bias_output_.begin(), bias_output_.end(), Scalar(0));
     }
 
     double TrainIteration(const std::bitset<InputNeurons> &input, const std::bitset<OutputNeurons> &target,
                           double learning_rate, double l2_lambda) {
-        std::array<double, HiddenNeurons> hidden_input{};
-        std::array<std::array<double, HiddenNeurons>, HiddenLayers> hidden_outputs{};
-        std::array<double, OutputNeurons> output_input{};
-        std::array<double, OutputNeurons> output{};
+        alignas(nn_kernels::alignment) Row hidden_input{};
+        alignas(nn_kernels::alignment) std::array<Row, HiddenLayers> hidden_outputs{};
+        std::array<Scalar, OutputNeurons> output{};
 
         // Forward pass
         // Input layer -> first hidden layer
-        // #pragma omp parallel for num_threads(8)
+        InputLayer(input, hidden_input);
         for (std::size_t i = 0; i < HiddenNeurons; ++i) {
-            hidden_input[i] = bias_hidden_[i];
-            for (std::size_t j = 0; j < InputNeurons; ++j) {
-                hidden_input[i] += input[j] * weights_input_hidden_[i][j];
-            }
-            if constexpr (AF == ActivationFunction::Sigmoid) {
-                hidden_outputs[0][i] = Sigmoid(hidden_input[i]);
-            } else {
-                hidden_outputs[0][i] = LeakyReLU(hidden_input[i]);
-            }
+            hidden_outputs[0][i] = Activate(hidden_input[i]);
         }
 
         // Hidden layers
         for (std::size_t h = 1; h < HiddenLayers; ++h) {
-            std::fill(hidden_input.begin(), hidden_input.end(), 0.0);
             // #pragma omp parallel for num_threads(8)
             for (std::size_t i = 0; i < HiddenNeurons; ++i) {
-                hidden_input[i] = bias_hidden_[i];
-                for (std::size_t j = 0; j < HiddenNeurons; ++j) {
-                    hidden_input[i] += hidden_outputs[h - 1][j] * weights_hidden_hidden_[h - 1][i][j];
-                }
-                if constexpr (AF == ActivationFunction::Sigmoid) {
-                    hidden_outputs[h][i] = Sigmoid(hidden_input[i]);
-                } else {
-                    hidden_outputs[h][i] = LeakyReLU(hidden_input[i]);
-                }
+                hidden_outputs[h][i] = Activate(bias_hidden_[i] + nn_kernels::dot(weights_hidden_hidden_[h - 1][i].data(),
+                                                                                  hidden_outputs[h - 1].data(),
+                                                                                  HiddenStride));
             }
         }
 
         // Last hidden layer -> output layer
         // #pragma omp parallel for num_threads(8)
         for (std::size_t i = 0; i < OutputNeurons; ++i) {
-            output_input[i] = bias_output_[i];
-            for (std::size_t j = 0; j < HiddenNeurons; ++j) {
-                output_input[i] += hidden_outputs[HiddenLayers - 1][j] * weights_hidden_output_[i][j];
-            }
-            output[i] = Sigmoid(output_input[i]);
+            output[i] = Sigmoid(bias_output_[i] + nn_kernels::dot(weights_hidden_output_[i].data(),
+                                                                  hidden_outputs[HiddenLayers - 1].data(),
+                                                                  HiddenStride));
         }
 
         // Backward pass
-        std::array<double, OutputNeurons> output_error{};
-        std::array<std::array<double, HiddenNeurons>, HiddenLayers> hidden_error{};
+        std::array<Scalar, OutputNeurons> output_error{};
+        alignas(nn_kernels::alignment) std::array<Row, HiddenLayers> hidden_error{};
 
         // Output layer error
-        // #pragma omp parallel for num_threads(8)
         for (std::size_t i = 0; i < OutputNeurons; ++i) {
-            output_error[i] = (double(target[i]) - output[i]) * SigmoidDerivative(output[i]);
+            output_error[i] = (Scalar(target[i]) - output[i]) * SigmoidDerivative(output[i]);
         }
 
-        // Hidden layers error
-        // #pragma omp parallel for num_threads(8)
+        // Hidden layers error: ошибка предыдущего слоя - сумма строк весов, взвешенных ошибками
+        for (std::size_t j = 0; j < OutputNeurons; ++j) {
+            nn_kernels::axpy(HiddenStride, output_error[j], weights_hidden_output_[j].data(),
+                             hidden_error[HiddenLayers - 1].data());
+        }
         for (std::size_t i = 0; i < HiddenNeurons; ++i) {
-            hidden_error[HiddenLayers - 1][i] = 0.0;
-            for (std::size_t j = 0; j < OutputNeurons; ++j) {
-                hidden_error[HiddenLayers - 1][i] += output_error[j] * weights_hidden_output_[j][i];
-            }
-            if constexpr (AF == ActivationFunction::Sigmoid) {
-                hidden_error[HiddenLayers - 1][i] *= SigmoidDerivative(hidden_outputs[HiddenLayers - 1][i]);
-            } else {
-                hidden_error[HiddenLayers - 1][i] *= LeakyReLUDerivative(hidden_outputs[HiddenLayers - 1][i]);
-            }
+            hidden_error[HiddenLayers - 1][i] *= ActivateDerivative(hidden_outputs[HiddenLayers - 1][i]);
         }
 
         for (int h = int(HiddenLayers) - 2; h >= 0; --h) {
-            // #pragma omp parallel for num_threads(8)
+            for (std::size_t j = 0; j < HiddenNeurons; ++j) {
+                nn_kernels::axpy(HiddenStride, hidden_error[h + 1][j], weights_hidden_hidden_[h][j].data(),
+                                 hidden_error[h].data());
+            }
             for (std::size_t i = 0; i < HiddenNeurons; ++i) {
-                hidden_error[h][i] = 0.0;
-                for (std::size_t j = 0; j < HiddenNeurons; ++j) {
-                    hidden_error[h][i] += hidden_error[h + 1][j] * weights_hidden_hidden_[h][j][i];
-                }
-                if constexpr (AF == ActivationFunction::Sigmoid) {
-                    hidden_error[h][i] *= SigmoidDerivative(hidden_outputs[h][i]);
-                } else {
-                    hidden_error[h][i] *= LeakyReLUDerivative(hidden_outputs[h][i]);
-                }
+                hidden_error[h][i] *= ActivateDerivative(hidden_outputs[h][i]);
             }
         }
 
-        // Update weights and biases
-        // #pragma omp parallel for num_threads(8)
+        // Update weights and biases: w = decay * w + lr * error * activation
+        const Scalar lr = Scalar(learning_rate);
+        const Scalar decay = Scalar(1.0 - learning_rate * l2_lambda);
         for (std::size_t i = 0; i < OutputNeurons; ++i) {
-            for (std::size_t j = 0; j < HiddenNeurons; ++j) {
-                weights_hidden_output_[i][j] += learning_rate * (output_error[i] * hidden_outputs[HiddenLayers - 1][j] -
-                                                                 l2_lambda * weights_hidden_output_[i][j]);
+            nn_kernels::axpby(HiddenStride, lr * output_error[i], hidden_outputs[HiddenLayers - 1].data(), decay,
+                              weights_hidden_output_[i].data());
+            bias_output_[i] += lr * output_error[i];
+        }
+
+        // Первый слой: градиент есть только у столбцов установленных битов, L2 затухание - у всех
+        if (l2_lambda != 0.0) {
+            Scalar *w = weights_input_hidden_.data();
+            for (std::size_t k = 0; k < InputNeurons * HiddenStride; ++k) {
+                w[k] *= decay;
             }
-            bias_output_[i] += learning_rate * output_error[i];
         }
+        ForEachSetBit(input, [&](std::size_t j) {
+            nn_kernels::axpy(HiddenStride, lr, hidden_error[0].data(), weights_input_hidden_[j].data());
+        });
 
         for (std::size_t h = 0; h < HiddenLayers; ++h) {
-            // #pragma omp parallel for num_threads(8)
-            for (std::size_t i = 0; i < HiddenNeurons; ++i) {
-                if (h == 0) {
-                    for (std::size_t j = 0; j < InputNeurons; ++j) {
-                        weights_input_hidden_[i][j] +=
-                            learning_rate * (hidden_error[h][i] * input[j] - l2_lambda * weights_input_hidden_[i][j]);
-                    }
-                } else {
-                    for (std::size_t j = 0; j < HiddenNeurons; ++j) {
-                        weights_hidden_hidden_[h - 1][i][j] +=
-                            learning_rate * (hidden_error[h][i] * hidden_outputs[h - 1][j] -
-                                             l2_lambda * weights_hidden_hidden_[h - 1][i][j]);
-                    }
+            if (h != 0) {
+                for (std::size_t i = 0; i < HiddenNeurons; ++i) {
+                    nn_kernels::axpby(HiddenStride, lr * hidden_error[h][i], hidden_outputs[h - 1].data(), decay,
+                                      weights_hidden_hidden_[h - 1][i].data());
                 }
-                bias_hidden_[i] += learning_rate * hidden_error[h][i];
             }
+            nn_kernels::axpy(HiddenStride, lr, hidden_error[h].data(), bias_hidden_.data());
         }
 
         // Calculate error
         double total_error = 0.0;
-        // #pragma omp parallel for reduction(+:total_error) num_threads(8)
         for (std::size_t i = 0; i < OutputNeurons; ++i) {
-            total_error += std::pow(double(target[i]) - output[i], 2);
+            double diff = double(target[i]) - double(output[i]);
+            total_error += diff * diff;
         }
 
         return total_error;
     }
 
+    // Прямой проход батча: input(b) - вход b-го сэмпла. В ws остаются входы, активации скрытых слоёв
+    // и суммы выходного слоя без смещения.
+    template <typename GetInput>
+    void ForwardBatch(std::size_t count, BatchWorkspace &ws, GetInput &&input) const {
+        constexpr std::size_t In = InputNeurons, H = HiddenNeurons, S = HiddenStride, Out = OutputNeurons;
+        ws.resize(count);
+        auto hidden = [&](std::size_t h) { return ws.hidden.data() + h * count * S; };
+
+        std::fill(ws.input.begin(), ws.input.begin() + count * In, Scalar(0));
+        for (std::size_t b = 0; b < count; ++b) {
+            ForEachSetBit(input(b), [&](std::size_t j) { ws.input[b * In + j] = Scalar(1); });
+        }
+
+        // веса первого слоя хранятся по входам, поэтому это gemm_nn без транспонирования; вход считается плотным:
+        // векторный simd::vecmat нули не пропускает (ветка на бинарных входах дороже лишних FMA)
+        // строки буфера сдвигаются при смене размера батча, поэтому дополнение обнуляется заново
+        std::fill(ws.hidden.begin(), ws.hidden.begin() + HiddenLayers * count * S, Scalar(0));
+        nn_kernels::gemm_nn(count, S, In, ws.input.data(), In, &weights_input_hidden_[0][0], S, hidden(0), S);
+        ActivateRows(hidden(0), count);
+        for (std::size_t h = 1; h < HiddenLayers; ++h) {
+            nn_kernels::gemm_nt(count, H, S, hidden(h - 1), S, &weights_hidden_hidden_[h - 1][0][0], S, hidden(h), S);
+            ActivateRows(hidden(h), count);
+        }
+        nn_kernels::gemm_nt(count, Out, S, hidden(HiddenLayers - 1), S, &weights_hidden_output_[0][0], S,
+                            ws.output.data(), Out);
+    }
+
+    // Прямой и обратный проход по батчу как произведения матриц, градиенты (сумма по батчу) добавляются в grad.
+    // Возвращает суммарную квадратичную ошибку батча.
+    double ComputeBatchGradients(const std::pair<std::bitset<InputNeurons>, std::bitset<OutputNeurons>> *samples,
+                                 std::size_t count, Gradients &grad, BatchWorkspace &ws) const {
+        constexpr std::size_t In = InputNeurons, H = HiddenNeurons, S = HiddenStride, Out = OutputNeurons;
+        auto hidden = [&](std::size_t h) { return ws.hidden.data() + h * count * S; };
+        auto hidden_error = [&](std::size_t h) { return ws.hidden_error.data() + h * count * S; };
+
+        // Forward pass
+        ForwardBatch(count, ws, [&](std::size_t b) -> const std::bitset<InputNeurons> & { return samples[b].first; });
+
+        // Output layer error
+        double total_error = 0.0;
+        for (std::size_t b = 0; b < count; ++b) {
+            for (std::size_t i = 0; i < Out; ++i) {
+                Scalar o = Sigmoid(ws.output[b * Out + i] + bias_output_[i]);
+                Scalar diff = Scalar(samples[b].second[i]) - o;
+                ws.output_error[b * Out + i] = diff * SigmoidDerivative(o);
+                total_error += double(diff) * double(diff);
+            }
+        }
+
+        // Backward pass
+        std::fill(ws.hidden_error.begin(), ws.hidden_error.begin() + HiddenLayers * count * S, Scalar(0));
+        nn_kernels::gemm_nn(count, S, Out, ws.output_error.data(), Out, &weights_hidden_output_[0][0], S,
+                            hidden_error(HiddenLayers - 1), S);
+        DeriveRows(hidden_error(HiddenLayers - 1), hidden(HiddenLayers - 1), count);
+        for (int h = int(HiddenLayers) - 2; h >= 0; --h) {
+            nn_kernels::gemm_nn(count, S, H, hidden_error(h + 1), S, &weights_hidden_hidden_[h][0][0], S,
+                                hidden_error(h), S);
+            DeriveRows(hidden_error(h), hidden(h), count);
+        }
+
+        // Gradients
+        nn_kernels::gemm_tn(Out, S, count, ws.output_error.data(), Out, hidden(HiddenLayers - 1), S,
+                            grad.block(HiddenOutputOffset), S);
+        nn_kernels::gemm_tn(In, S, count, ws.input.data(), In, hidden_error(0), S, grad.block(InputHiddenOffset), S);
+        for (std::size_t h = 1; h < HiddenLayers; ++h) {
+            nn_kernels::gemm_tn(H, S, count, hidden_error(h), S, hidden(h - 1), S,
+                                grad.block(HiddenHiddenOffset) + (h - 1) * H * S, S);
+        }
+        for (std::size_t b = 0; b < count; ++b) {
+            for (std::size_t i = 0; i < Out; ++i) {
+                grad.block(BiasOutputOffset)[i] += ws.output_error[b * Out + i];
+            }
+            // смещения скрытых слоёв общие для всех слоёв, как и в TrainIteration
+            for (std::size_t h = 0; h < HiddenLayers; ++h) {
+                nn_kernels::axpy(S, Scalar(1), hidden_error(h) + b * S, grad.block(BiasHiddenOffset));
+            }
+        }
+
+        return total_error;
+    }
+
+    // Шаг по градиенту, усреднённому по count сэмплам, с L2 как в TrainIteration (затухание весов, не смещений).
+    // SGD: w += lr * g; Momentum: m = mu * m + g, w += lr * m; Adam - с поправкой моментов на смещение.
+    // state - состояние оптимизатора сети, в hogwild - своё у каждого потока.
+    void ApplyGradients(const Gradients &grad, std::size_t count, double learning_rate, double l2_lambda,
+                        OptimizerState &state) {
+        const Scalar scale = Scalar(1.0 / double(count));
+        const Scalar lr = Scalar(learning_rate);
+        const Scalar weight_decay = Scalar(1.0 - learning_rate * l2_lambda);
+        const Optimizer optimizer = options_.optimizer;
+
+        Scalar mu = Scalar(options_.momentum), beta1 = Scalar(options_.beta1), beta2 = Scalar(options_.beta2);
+        Scalar epsilon = Scalar(options_.epsilon), correction1 = 1, correction2 = 1;
+        if (optimizer == Optimizer::Adam) {
+            std::size_t t = ++state.step;
+            correction1 = Scalar(1.0 / (1.0 - std::pow(options_.beta1, double(t))));
+            correction2 = Scalar(1.0 / (1.0 - std::pow(options_.beta2, double(t))));
+        }
+
+        auto update = [&](Scalar &w, Scalar g, Scalar *m, Scalar *v, Scalar decay) {
+            g *= scale;
+            switch (optimizer) {
+            case Optimizer::SGD:
+                w = decay * w + lr * g;
+                break;
+            case Optimizer::Momentum:
+                *m = mu * *m + g;
+                w = decay * w + lr * *m;
+                break;
+            case Optimizer::Adam:
+                *m = beta1 * *m + (1 - beta1) * g;
+                *v = beta2 * *v + (1 - beta2) * g * g;
+                w = decay * w + lr * (*m * correction1) / (std::sqrt(*v * correction2) + epsilon);
+                break;
+            }
+        };
+        Scalar *w = weights_;
+        const Scalar *g = grad.values.data();
+        Scalar *m = state.first_moment.data(), *v = state.second_moment.data();
+        auto at = [](Scalar *p, std::size_t k) { return p ? p + k : nullptr; };
+
+        // все веса до смещений - один блок; SGD и Momentum векторными ядрами
+        constexpr std::size_t weights = BiasHiddenOffset;
+        if (optimizer == Optimizer::SGD) {
+            nn_kernels::axpby(weights, lr * scale, g, weight_decay, w);
+        } else if (optimizer == Optimizer::Momentum) {
+            nn_kernels::axpby(weights, scale, g, mu, m);
+            nn_kernels::axpby(weights, lr, m, weight_decay, w);
+        } else {
+            for (std::size_t k = 0; k < weights; ++k) {
+                update(w[k], g[k], at(m, k), at(v, k), weight_decay);
+            }
+        }
+        // смещения короткие и без затухания, им хватает скалярного цикла; дополнение остаётся нулевым
+        for (std::size_t k = weights; k < ParameterCount; ++k) {
+            update(w[k], g[k], at(m, k), at(v, k), Scalar(1));
+        }
+    }
+
+    // Один шаг мини-батча; при count = 1 совпадает с TrainIteration с точностью до порядка округлений
+    double TrainBatch(const std::pair<std::bitset<InputNeurons>, std::bitset<OutputNeurons>> *samples,
+                      std::size_t count, double learning_rate, double l2_lambda) {
+        if (!batch_grad_) {
+            batch_grad_.emplace();
+        }
+        batch_grad_->clear();
+        double error = ComputeBatchGradients(samples, count, *batch_grad_, batch_ws_);
+        ApplyGradients(*batch_grad_, count, learning_rate, l2_lambda, optimizer_state_);
+        return error;
+    }
+
+    // Синхронный data-parallel шаг: батч делится на шарды по потокам пула, у каждого потока свой буфер
+    // градиентов, буферы складываются попарным деревом, затем один общий шаг. Результат совпадает с TrainBatch
+    // с точностью до порядка суммирования.
+    double TrainBatchParallel(const std::pair<std::bitset<InputNeurons>, std::bitset<OutputNeurons>> *samples,
+                              std::size_t count, double learning_rate, double l2_lambda, ThreadPool &pool) {
+        std::size_t shards = std::min(pool.size(), count);
+        if (shards <= 1) {
+            return TrainBatch(samples, count, learning_rate, l2_lambda);
+        }
+        if (shard_grad_.size() < shards) {
+            shard_grad_.resize(shards);
+            shard_ws_.resize(shards);
+        }
+
+        std::vector<double> errors(shards, 0.0);
+        pool.run(shards, [&](std::size_t t) {
+            std::size_t begin = count * t / shards, end = count * (t + 1) / shards;
+            shard_grad_[t].clear();
+            errors[t] = ComputeBatchGradients(samples + begin, end - begin, shard_grad_[t], shard_ws_[t]);
+        });
+
+        ReduceGradients(shard_grad_, shards, pool);
+        ApplyGradients(shard_grad_[0], count, learning_rate, l2_lambda, optimizer_state_);
+
+        double total_error = 0.0;
+        for (double e : errors) {
+            total_error += e;
+        }
+        return total_error;
+    }
+
+    // сумма grads[0..n) в grads[0] попарным деревом, уровни дерева выполняются параллельно
+    static void ReduceGradients(std::vector<Gradients> &grads, std::size_t n, ThreadPool &pool) {
+        for (std::size_t stride = 1; stride < n; stride *= 2) {
+            std::size_t pairs = (n - stride + 2 * stride - 1) / (2 * stride);
+            pool.run(pairs, [&](std::size_t p) {
+                std::size_t dst = p * 2 * stride, src = dst + stride;
+                if (src < n) {
+                    grads[dst].add(grads[src]);
+                }
+            });
+        }
+    }
+
+    // Hogwild: потоки берут батчи по очереди и применяют свои градиенты к общим весам без блокировок.
+    // Гонки при записи весов допускаются намеренно: при разреженных обновлениях они почти не мешают сходимости.
+    // Моменты Momentum/Adam и счётчик шагов у каждого потока свои: общие были бы гонкой данных (UB), а поправка
+    // Adam зависела бы от чередования потоков. Состояние потоков живёт между эпохами, общее не меняется.
+    double TrainEpochHogwild(const std::pair<std::bitset<InputNeurons>, std::bitset<OutputNeurons>> *samples,
+                             std::size_t count, std::size_t batch_size, double learning_rate, double l2_lambda,
+                             ThreadPool &pool) {
+        std::size_t threads = pool.size();
+        if (shard_grad_.size() < threads) {
+            shard_grad_.resize(threads);
+            shard_ws_.resize(threads);
+        }
+        if (shard_optimizer_.size() < threads) {
+            shard_optimizer_.resize(threads);
+        }
+        for (std::size_t t = 0; t < threads; ++t) {
+            shard_optimizer_[t].prepare(options_.optimizer);
+        }
+        std::size_t batches = (count + batch_size - 1) / batch_size;
+
+        std::vector<double> errors(threads, 0.0);
+        pool.run(threads, [&](std::size_t t) {
+            for (std::size_t b = t; b < batches; b += threads) {
+                std::size_t begin = b * batch_size, size = std::min(batch_size, count - begin);
+                shard_grad_[t].clear();
+                errors[t] += ComputeBatchGradients(samples + begin, size, shard_grad_[t], shard_ws_[t]);
+                ApplyGradients(shard_grad_[t], size, learning_rate, l2_lambda, shard_optimizer_[t]);
+            }
+        });
+
+        double total_error = 0.0;
+        for (double e : errors) {
+            total_error += e;
+        }
+        return total_error;
+    }
+
     bool save_to_file(std::string filename) {
         std::ofstream file(filename);
         if (!file.is_open()) {
@@ -346,10 +839,11 @@ class NeuralNetwork {
         }
 
         file << InputNeurons << " " << HiddenLayers << " " << HiddenNeurons << " " << OutputNeurons << std::endl;
+        file << std::setprecision(std::numeric_limits<Scalar>::max_digits10); // чтение вернёт те же веса
 
         for (std::size_t i = 0; i < HiddenNeurons; ++i) {
             for (std::size_t j = 0; j < InputNeurons; ++j) {
-                file << weights_input_hidden_[i][j] << " ";
+                file << weights_input_hidden_[j][i] << " ";
             }
             file << std::endl;
         }
@@ -400,7 +894,7 @@ class NeuralNetwork {
 
         for (std::size_t i = 0; i < HiddenNeurons; ++i) {
             for (std::size_t j = 0; j < InputNeurons; ++j) {
-                file >> weights_input_hidden_[i][j];
+                file >> weights_input_hidden_[j][i];
             }
         }
 
@@ -430,13 +924,114 @@ class NeuralNetwork {
         return true;
     }
 
-    std::array<std::array<double, InputNeurons>, HiddenNeurons> weights_input_hidden_;
-    std::array<std::array<std::array<double, HiddenNeurons>, HiddenNeurons>, HiddenLayers - 1> weights_hidden_hidden_;
-    std::array<std::array<double, HiddenNeurons>, OutputNeurons> weights_hidden_output_;
-    std::array<double, HiddenNeurons> bias_hidden_;
-    std::array<double, OutputNeurons> bias_output_;
+    // заголовок файла для сети этого типа, контрольную сумму заполняет Writer
+    static nn_file::Header BinaryHeader() {
+        nn_file::Header h;
+        h.input = InputNeurons;
+        h.hidden_layers = HiddenLayers;
+        h.hidden = HiddenNeurons;
+        h.output = OutputNeurons;
+        h.activation = AF;
+        h.scalar_size = sizeof(Scalar);
+        // блоки файла идут в той же раскладке, что и params_
+        assert(h.file_size() == nn_file::header_size + ParameterCount * sizeof(Scalar));
+        return h;
+    }
 
-    std::random_device rd;
-    std::mt19937 gen;
-    std::uniform_real_distribution<double> dist;
+    // Бинарный формат nn_file: веса пишутся блоками в раскладке памяти, с контрольной суммой
+    bool save_binary(const std::string &filename) const {
+        nn_file::Writer writer(BinaryHeader());
+        writer.block(nn_file::header_size, weights_, ParameterCount);
+        return writer.save(filename);
+    }
+
+    // Файл отображается в память, блоки параметров копируются одним memcpy в собственный буфер; false, если
+    // размеры, активация или тип весов не совпадают с этой сетью или файл повреждён
+    bool load_binary(const std::string &filename) {
+        utils::MappedFile file(filename);
+        if (!CheckBinary(file)) {
+            return false;
+        }
+        if (mapped_) {
+            params_.assign(ParameterCount, Scalar(0));
+            mapped_.reset();
+            BindViews(params_.data());
+        }
+        std::memcpy(weights_, file.data() + nn_file::header_size, ParameterCount * sizeof(Scalar));
+        return true;
+    }
+
+    // Как load_binary, но без копирования: представления весов указывают прямо в отображение файла, которое
+    // живёт вместе с сетью, собственный буфер освобождается. Блоки файла выровнены как в params_ (заголовок -
+    // 64 байта от начала страницы). Отображение copy-on-write: дообучение меняет только затронутые страницы
+    // в памяти процесса, файл остаётся прежним. Сразу проверяются только заголовок и размеры: контрольная сумма
+    // прочитала бы все страницы, поэтому она считается лишь при verify.
+    bool map_binary(const std::string &filename, bool verify = false) {
+        auto file = std::make_unique<utils::MappedFile>(filename, utils::MappedFile::CopyOnWrite);
+        if (!CheckBinary(*file, verify)) {
+            return false;
+        }
+        mapped_ = std::move(file);
+        nn_kernels::aligned_vector<Scalar>().swap(params_);
+        BindViews(reinterpret_cast<Scalar *>(mapped_->writable_data() + nn_file::header_size));
+        return true;
+    }
+
+    // веса лежат в отображении файла (map_binary)
+    bool is_mapped() const { return mapped_ != nullptr; }
+
+    // Представления блоков параметров: params_ или, после map_binary, отображения файла mapped_. Веса первого
+    // слоя хранятся по входам: столбец установленного бита лежит в памяти подряд. Дополнение строк
+    // до HiddenStride нулевое, буфер создаётся заполненным нулями.
+    nn_kernels::aligned_vector<Scalar> params_;
+    std::unique_ptr<utils::MappedFile> mapped_;
+    Scalar *weights_ = nullptr; // начало блоков параметров
+    nn_kernels::rows_view<Scalar, HiddenStride> weights_input_hidden_;
+    std::array<nn_kernels::rows_view<Scalar, HiddenStride>, HiddenLayers - 1> weights_hidden_hidden_;
+    nn_kernels::rows_view<Scalar, HiddenStride> weights_hidden_output_;
+    nn_kernels::vector_view<Scalar, HiddenStride> bias_hidden_;
+    nn_kernels::vector_view<Scalar, OutputNeurons> bias_output_;
+
+    TrainOptions options_;
+    OptimizerState optimizer_state_;
+    std::vector<OptimizerState> shard_optimizer_; // hogwild: по состоянию на поток пула
+
+    // буферы обучения создаются при первом батче, копия сети их не выделяет
+    std::optional<Gradients> batch_grad_;
+    BatchWorkspace batch_ws_;
+    std::vector<Gradients> shard_grad_; // по буферу на поток пула
+    std::vector<BatchWorkspace> shard_ws_;
+
+  private:
+    // заголовок файла и совпадение формы, активации и типа весов с этой сетью; контрольная сумма - при verify
+    static bool CheckBinary(const utils::MappedFile &file, bool verify = true) {
+        nn_file::Header h;
+        if (!file.is_open() || !nn_file::read_header(file.data(), file.size(), h, verify)) {
+            return false;
+        }
+        nn_file::Header expected = BinaryHeader();
+        return h.input == expected.input && h.hidden_layers == expected.hidden_layers &&
+               h.hidden == expected.hidden && h.output == expected.output && h.activation == AF &&
+               h.scalar_size == sizeof(Scalar);
+    }
+
+    void BindViews(Scalar *p) {
+        weights_ = p;
+        weights_input_hidden_ = {p + InputHiddenOffset, InputNeurons};
+        for (std::size_t h = 0; h + 1 < HiddenLayers; ++h) {
+            weights_hidden_hidden_[h] = {p + HiddenHiddenOffset + h * HiddenNeurons * HiddenStride, HiddenNeurons};
+        }
+        weights_hidden_output_ = {p + HiddenOutputOffset, OutputNeurons};
+        bias_hidden_ = nn_kernels::vector_view<Scalar, HiddenStride>(p + BiasHiddenOffset);
+        bias_output_ = nn_kernels::vector_view<Scalar, OutputNeurons>(p + BiasOutputOffset);
+    }
+
+    void UnbindViews() {
+        weights_ = nullptr;
+        weights_input_hidden_ = {};
+        weights_hidden_hidden_ = {};
+        weights_hidden_output_ = {};
+        bias_hidden_ = {};
+        bias_output_ = {};
+    }
 };
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "activations.hpp"
+#include "hashing.hpp"
+#include "mapped_file.hpp"
+#include "nn_kernels.hpp"
+
+// Бинарный формат весов NeuralNetwork.
+// Заголовок 64 байта, за ним блоки весов в той же раскладке, что и в памяти сети: строки дополнены нулями
+// до HiddenStride, каждый блок выровнен на 64 байта. Поэтому загрузка из отображённого файла - одно копирование
+// на блок без разбора, а смещения блоков годятся и для работы прямо по отображению.
+// Числа в нативном порядке байт; файл с другим порядком отвергается по маркеру в заголовке.
+namespace nn_file {
+
+constexpr char magic[8] = {'B', 'U', 'G', 'S', 'N', 'N', 'E', 'T'};
+constexpr uint32_t version = 1;
+constexpr uint32_t byte_order = 0x01020304;
+constexpr std::size_t header_size = 64;
+
+inline std::size_t align_block(std::size_t bytes) {
+    return (bytes + nn_kernels::alignment - 1) / nn_kernels::alignment * nn_kernels::alignment;
+}
+
+// Смещения блоков считаются от начала файла
+struct Header {
+    uint32_t input = 0, hidden_layers = 0, hidden = 0, output = 0;
+    ActivationFunction activation = ActivationFunction::Sigmoid;
+    uint32_t scalar_size = sizeof(double); // 4 - float, 8 - double
+    uint64_t checksum = 0;                  // hash_bytes по всем блокам
+
+    std::size_t stride() const {
+        return scalar_size == sizeof(float) ? nn_kernels::padded<float>(hidden) : nn_kernels::padded<double>(hidden);
+    }
+    std::size_t input_hidden_offset() const { return header_size; }
+    std::size_t hidden_hidden_offset() const {
+        return input_hidden_offset() + align_block(input * stride() * scalar_size);
+    }
+    std::size_t hidden_output_offset() const {
+        return hidden_hidden_offset() + align_block((hidden_layers - 1) * hidden * stride() * scalar_size);
+    }
+    std::size_t bias_hidden_offset() const {
+        return hidden_output_offset() + align_block(output * stride() * scalar_size);
+    }
+    std::size_t bias_output_offset() const { return bias_hidden_offset() + align_block(stride() * scalar_size); }
+    std::size_t file_size() const { return bias_output_offset() + align_block(output * scalar_size); }
+};
+
+inline uint64_t checksum(const unsigned char *data, std::size_t size) { return utils::hash_bytes(data, size).lo; }
+
+inline void write_header(unsigned char *dst, const Header &h) {
+    std::memset(dst, 0, header_size);
+    std::memcpy(dst, magic, sizeof(magic));
+    uint32_t fields[] = {version,  byte_order, h.input, h.hidden_layers, h.hidden, h.output, uint32_t(h.activation),
+                         h.scalar_size, uint32_t(h.stride())};
+    std::memcpy(dst + 8, fields, sizeof(fields));
+    uint64_t size = h.file_size();
+    std::memcpy(dst + 48, &size, sizeof(size));
+    std::memcpy(dst + 56, &h.checksum, sizeof(h.checksum));
+}
+
+// Проверяет заголовок, размер файла и, при verify_checksum, контрольную сумму. Сумма читает весь файл, поэтому
+// для отображённого файла её можно пропустить, чтобы страницы весов подгружались лениво.
+inline bool read_header(const unsigned char *src, std::size_t size, Header &h, bool verify_checksum = true) {
+    if (size < header_size || std::memcmp(src, magic, sizeof(magic)) != 0) {
+        return false;
+    }
+    uint32_t fields[9];
+    std::memcpy(fields, src + 8, sizeof(fields));
+    if (fields[0] != version || fields[1] != byte_order) {
+        return false;
+    }
+    h.input = fields[2];
+    h.hidden_layers = fields[3];
+    h.hidden = fields[4];
+    h.output = fields[5];
+    h.activation = ActivationFunction(fields[6]);
+    h.scalar_size = fields[7];
+    if ((h.scalar_size != sizeof(float) && h.scalar_size != sizeof(double)) || h.hidden_layers == 0 ||
+        fields[8] != h.stride()) {
+        return false;
+    }
+    uint64_t file_size;
+    std::memcpy(&file_size, src + 48, sizeof(file_size));
+    std::memcpy(&h.checksum, src + 56, sizeof(h.checksum));
+    if (file_size != h.file_size() || size < file_size) {
+        return false;
+    }
+    return !verify_checksum || checksum(src + header_size, file_size - header_size) == h.checksum;
+}
+
+// Собирает файл из блоков в раскладке сети; контрольная сумма считается здесь
+class Writer {
+  public:
+    explicit Writer(Header header) : header(header), buffer(header.file_size(), 0) {}
+
+    template <typename Scalar>
+    void block(std::size_t offset, const Scalar *data, std::size_t count) {
+        std::memcpy(buffer.data() + offset, data, count * sizeof(Scalar));
+    }
+
+    bool save(const std::string &filename) {
+        header.checksum = checksum(buffer.data() + header_size, buffer.size() - header_size);
+        write_header(buffer.data(), header);
+        std::ofstream file(filename, std::ios::binary);
+        file.write(reinterpret_cast<const char *>(buffer.data()), std::streamsize(buffer.size()));
+        return bool(file);
+    }
+
+    Header header;
+    std::vector<unsigned char> buffer;
+};
+
+// Переводит текстовый файл save_to_file в бинарный. Размеры берутся из текстового заголовка, активация и тип
+// весов в тексте не хранятся и задаются здесь.
+template <typename Scalar = double>
+bool convert_text_model(const std::string &text_filename, const std::string &binary_filename,
+                        ActivationFunction activation = ActivationFunction::Sigmoid) {
+    std::ifstream file(text_filename);
+    Header h;
+    if (!(file >> h.input >> h.hidden_layers >> h.hidden >> h.output) || h.hidden_layers == 0) {
+        return false;
+    }
+    h.activation = activation;
+    h.scalar_size = sizeof(Scalar);
+    const std::size_t stride = h.stride();
+
+    Writer writer(h);
+    auto at = [&](std::size_t offset, std::size_t index) -> Scalar & {
+        return reinterpret_cast<Scalar *>(writer.buffer.data() + offset)[index];
+    };
+    // порядок чисел в тексте: [нейрон][вход], в памяти первый слой хранится по входам
+    for (std::size_t i = 0; i < h.hidden; ++i) {
+        for (std::size_t j = 0; j < h.input; ++j) {
+            file >> at(h.input_hidden_offset(), j * stride + i);
+        }
+    }
+    for (std::size_t r = 0; r < (h.hidden_layers - 1) * h.hidden; ++r) {
+        for (std::size_t j = 0; j < h.hidden; ++j) {
+            file >> at(h.hidden_hidden_offset(), r * stride + j);
+        }
+    }
+    for (std::size_t i = 0; i < h.output; ++i) {
+        for (std::size_t j = 0; j < h.hidden; ++j) {
+            file >> at(h.hidden_output_offset(), i * stride + j);
+        }
+    }
+    for (std::size_t i = 0; i < h.hidden; ++i) {
+        file >> at(h.bias_hidden_offset(), i);
+    }
+    for (std::size_t i = 0; i < h.output; ++i) {
+        file >> at(h.bias_output_offset(), i);
+    }
+    return file && writer.save(binary_filename);
+}
+
+} // namespace nn_file
@@ -0,0 +1,423 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Блочные матричные ядра для батчевого обучения NeuralNetwork.
+// Все матрицы row-major, ld* - шаг строки в элементах.
+namespace nn_kernels {
+
+// размер блока подобран так, чтобы блок строк весов 81x81 double помещался в L1/L2
+constexpr std::size_t block = 64;
+
+// выравнивание строк весов: кэш-линия, она же ширина регистра AVX-512
+constexpr std::size_t alignment = 64;
+
+// длина строки из n элементов, дополненная нулями до целого числа кэш-линий
+template <typename T>
+constexpr std::size_t padded(std::size_t n) {
+    constexpr std::size_t lanes = alignment / sizeof(T);
+    return (n + lanes - 1) / lanes * lanes;
+}
+
+// аллокатор с выравниванием по кэш-линии для весов и буферов на куче
+template <typename T>
+struct AlignedAllocator {
+    using value_type = T;
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U> &) {}
+
+    T *allocate(std::size_t n) { return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(alignment))); }
+    void deallocate(T *p, std::size_t) { ::operator delete(p, std::align_val_t(alignment)); }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U> &) const {
+        return true;
+    }
+};
+
+template <typename T>
+using aligned_vector = std::vector<T, AlignedAllocator<T>>;
+
+// Невладеющие представления частей плоского буфера параметров. Константное представление даёт только
+// константный доступ к элементам, как std::array.
+template <typename T, std::size_t N>
+class vector_view {
+  public:
+    vector_view() = default;
+    explicit vector_view(T *data) : data_(data) {}
+
+    T &operator[](std::size_t i) { return data_[i]; }
+    const T &operator[](std::size_t i) const { return data_[i]; }
+
+    T *data() { return data_; }
+    const T *data() const { return data_; }
+    T *begin() { return data_; }
+    T *end() { return data_ + N; }
+    const T *begin() const { return data_; }
+    const T *end() const { return data_ + N; }
+    static constexpr std::size_t size() { return N; }
+
+  private:
+    T *data_ = nullptr;
+};
+
+// rows строк по Cols элементов подряд
+template <typename T, std::size_t Cols>
+class rows_view {
+  public:
+    rows_view() = default;
+    rows_view(T *data, std::size_t rows) : data_(data), rows_(rows) {}
+
+    vector_view<T, Cols> operator[](std::size_t r) { return vector_view<T, Cols>(data_ + r * Cols); }
+    const vector_view<T, Cols> operator[](std::size_t r) const { return vector_view<T, Cols>(data_ + r * Cols); }
+
+    T *data() { return data_; }
+    const T *data() const { return data_; }
+    std::size_t size() const { return rows_; }
+
+  private:
+    T *data_ = nullptr;
+    std::size_t rows_ = 0;
+};
+
+// Операции над строками. Шаблоны - переносимый вариант, для float и double при сборке с AVX2+FMA или AVX-512
+// ниже есть векторные перегрузки, которые выбираются обычным разрешением перегрузок.
+
+// сумма a[i] * b[i]
+template <typename T>
+T dot(const T *a, const T *b, std::size_t n) {
+    T sum = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// y += alpha * x
+template <typename T>
+void axpy(std::size_t n, T alpha, const T *x, T *y) {
+    for (std::size_t i = 0; i < n; ++i) {
+        y[i] += alpha * x[i];
+    }
+}
+
+// y = alpha * x + beta * y
+template <typename T>
+void axpby(std::size_t n, T alpha, const T *x, T beta, T *y) {
+    for (std::size_t i = 0; i < n; ++i) {
+        y[i] = alpha * x[i] + beta * y[i];
+    }
+}
+
+// c[0..n) += sum_p a[p] * b[p][0..n), строки b с шагом ldb; здесь нулевые a[p] пропускаются
+template <typename T>
+void vecmat(std::size_t n, std::size_t k, const T *a, const T *b, std::size_t ldb, T *c) {
+    for (std::size_t p = 0; p < k; ++p) {
+        if (a[p] != T(0)) {
+            axpy(n, a[p], b + p * ldb, c);
+        }
+    }
+}
+
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__))
+namespace simd {
+
+// горизонтальные суммы 256-битных регистров
+inline float hsum(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+
+inline double hsum(__m256d v) {
+    __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+
+// Описание регистра для обобщённых ядер. Загрузки невыровненные: на выровненных адресах они не медленнее,
+// а строки батча (например, 72 входа) начинаются не на границе кэш-линии.
+#if defined(__AVX512F__)
+struct floats {
+    using type = float;
+    using reg = __m512;
+    static constexpr std::size_t lanes = 16;
+    static reg zero() { return _mm512_setzero_ps(); }
+    static reg set1(float x) { return _mm512_set1_ps(x); }
+    static reg load(const float *p) { return _mm512_loadu_ps(p); }
+    static void store(float *p, reg v) { _mm512_storeu_ps(p, v); }
+    static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm512_mul_ps(a, b); }
+    static reg fmadd(reg a, reg b, reg c) { return _mm512_fmadd_ps(a, b, c); }
+    // Половины складываются и досуммируются как в AVX2. Не _mm512_reduce_add_ps и не обычные extract/cast:
+    // в GCC 12 они построены на _mm256_undefined_* и дают ложные -Wuninitialized в каждом TU; версия с полной
+    // маской компилируется в тот же vextractf64x4.
+    static float sum(reg v) {
+        __m512d d = _mm512_castps_pd(v);
+        return hsum(_mm256_add_ps(_mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, d, 0)),
+                                  _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, d, 1))));
+    }
+};
+
+struct doubles {
+    using type = double;
+    using reg = __m512d;
+    static constexpr std::size_t lanes = 8;
+    static reg zero() { return _mm512_setzero_pd(); }
+    static reg set1(double x) { return _mm512_set1_pd(x); }
+    static reg load(const double *p) { return _mm512_loadu_pd(p); }
+    static void store(double *p, reg v) { _mm512_storeu_pd(p, v); }
+    static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm512_mul_pd(a, b); }
+    static reg fmadd(reg a, reg b, reg c) { return _mm512_fmadd_pd(a, b, c); }
+    static double sum(reg v) {
+        return hsum(_mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xF, v, 0), _mm512_maskz_extractf64x4_pd(0xF, v, 1)));
+    }
+};
+#else
+struct floats {
+    using type = float;
+    using reg = __m256;
+    static constexpr std::size_t lanes = 8;
+    static reg zero() { return _mm256_setzero_ps(); }
+    static reg set1(float x) { return _mm256_set1_ps(x); }
+    static reg load(const float *p) { return _mm256_loadu_ps(p); }
+    static void store(float *p, reg v) { _mm256_storeu_ps(p, v); }
+    static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_ps(a, b); }
+    static reg fmadd(reg a, reg b, reg c) { return _mm256_fmadd_ps(a, b, c); }
+    static float sum(reg v) { return hsum(v); }
+};
+
+struct doubles {
+    using type = double;
+    using reg = __m256d;
+    static constexpr std::size_t lanes = 4;
+    static reg zero() { return _mm256_setzero_pd(); }
+    static reg set1(double x) { return _mm256_set1_pd(x); }
+    static reg load(const double *p) { return _mm256_loadu_pd(p); }
+    static void store(double *p, reg v) { _mm256_storeu_pd(p, v); }
+    static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+    static reg mul(reg a, reg b) { return _mm256_mul_pd(a, b); }
+    static reg fmadd(reg a, reg b, reg c) { return _mm256_fmadd_pd(a, b, c); }
+    static double sum(reg v) { return hsum(v); }
+};
+#endif
+
+// два независимых аккумулятора, чтобы не упираться в задержку FMA
+template <typename V, typename T = typename V::type>
+T dot(const T *a, const T *b, std::size_t n) {
+    constexpr std::size_t L = V::lanes;
+    auto acc0 = V::zero(), acc1 = V::zero();
+    std::size_t i = 0;
+    for (; i + 2 * L <= n; i += 2 * L) {
+        acc0 = V::fmadd(V::load(a + i), V::load(b + i), acc0);
+        acc1 = V::fmadd(V::load(a + i + L), V::load(b + i + L), acc1);
+    }
+    for (; i + L <= n; i += L) {
+        acc0 = V::fmadd(V::load(a + i), V::load(b + i), acc0);
+    }
+    return V::sum(V::add(acc0, acc1)) + nn_kernels::dot<T>(a + i, b + i, n - i);
+}
+
+template <typename V, typename T = typename V::type>
+void axpy(std::size_t n, T alpha, const T *x, T *y) {
+    constexpr std::size_t L = V::lanes;
+    auto va = V::set1(alpha);
+    std::size_t i = 0;
+    for (; i + L <= n; i += L) {
+        V::store(y + i, V::fmadd(va, V::load(x + i), V::load(y + i)));
+    }
+    nn_kernels::axpy<T>(n - i, alpha, x + i, y + i);
+}
+
+template <typename V, typename T = typename V::type>
+void axpby(std::size_t n, T alpha, const T *x, T beta, T *y) {
+    constexpr std::size_t L = V::lanes;
+    auto va = V::set1(alpha), vb = V::set1(beta);
+    std::size_t i = 0;
+    for (; i + L <= n; i += L) {
+        V::store(y + i, V::fmadd(va, V::load(x + i), V::mul(vb, V::load(y + i))));
+    }
+    nn_kernels::axpby<T>(n - i, alpha, x + i, beta, y + i);
+}
+
+// Строка c держится в регистрах полосами по 4 регистра, пока по ней проходят все строки b: в отличие от
+// цепочки axpy, c не перечитывается из памяти после каждой записи. Нули в a не пропускаются: на бинарных входах
+// такая ветка непредсказуема и обходится дороже лишних FMA.
+template <typename V, typename T = typename V::type>
+void vecmat(std::size_t n, std::size_t k, const T *a, const T *b, std::size_t ldb, T *c) {
+    constexpr std::size_t L = V::lanes;
+    std::size_t j = 0;
+    for (; j + 4 * L <= n; j += 4 * L) {
+        auto c0 = V::load(c + j), c1 = V::load(c + j + L), c2 = V::load(c + j + 2 * L), c3 = V::load(c + j + 3 * L);
+        for (std::size_t p = 0; p < k; ++p) {
+            auto va = V::set1(a[p]);
+            const T *row = b + p * ldb + j;
+            c0 = V::fmadd(va, V::load(row), c0);
+            c1 = V::fmadd(va, V::load(row + L), c1);
+            c2 = V::fmadd(va, V::load(row + 2 * L), c2);
+            c3 = V::fmadd(va, V::load(row + 3 * L), c3);
+        }
+        V::store(c + j, c0);
+        V::store(c + j + L, c1);
+        V::store(c + j + 2 * L, c2);
+        V::store(c + j + 3 * L, c3);
+    }
+    for (; j + L <= n; j += L) {
+        auto c0 = V::load(c + j);
+        for (std::size_t p = 0; p < k; ++p) {
+            c0 = V::fmadd(V::set1(a[p]), V::load(b + p * ldb + j), c0);
+        }
+        V::store(c + j, c0);
+    }
+    if (j < n) {
+        for (std::size_t p = 0; p < k; ++p) {
+            nn_kernels::axpy<T>(n - j, a[p], b + p * ldb + j, c + j); // переносимый вариант для хвоста
+        }
+    }
+}
+
+} // namespace simd
+
+inline float dot(const float *a, const float *b, std::size_t n) { return simd::dot<simd::floats>(a, b, n); }
+inline double dot(const double *a, const double *b, std::size_t n) { return simd::dot<simd::doubles>(a, b, n); }
+
+inline void axpy(std::size_t n, float alpha, const float *x, float *y) { simd::axpy<simd::floats>(n, alpha, x, y); }
+inline void axpy(std::size_t n, double alpha, const double *x, double *y) {
+    simd::axpy<simd::doubles>(n, alpha, x, y);
+}
+
+inline void axpby(std::size_t n, float alpha, const float *x, float beta, float *y) {
+    simd::axpby<simd::floats>(n, alpha, x, beta, y);
+}
+inline void axpby(std::size_t n, double alpha, const double *x, double beta, double *y) {
+    simd::axpby<simd::doubles>(n, alpha, x, beta, y);
+}
+
+inline void vecmat(std::size_t n, std::size_t k, const float *a, const float *b, std::size_t ldb, float *c) {
+    simd::vecmat<simd::floats>(n, k, a, b, ldb, c);
+}
+inline void vecmat(std::size_t n, std::size_t k, const double *a, const double *b, std::size_t ldb, double *c) {
+    simd::vecmat<simd::doubles>(n, k, a, b, ldb, c);
+}
+#endif
+
+// Целочисленное скалярное произведение int8 для квантованного вывода, сумма в int32.
+// n - любое, но быстрый путь рассчитан на строки, дополненные до кэш-линии.
+inline int32_t dot_i8(const int8_t *a, const int8_t *b, std::size_t n) {
+    int32_t sum = 0;
+    std::size_t i = 0;
+#if defined(__AVX512BW__) || defined(__AVX2__)
+    __m256i acc = _mm256_setzero_si256();
+#if defined(__AVX512BW__)
+    __m512i wide = _mm512_setzero_si512();
+    for (; i + 32 <= n; i += 32) {
+        __m512i va = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i)));
+        __m512i vb = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i)));
+        wide = _mm512_add_epi32(wide, _mm512_madd_epi16(va, vb));
+    }
+    // половины складываются как в редукциях float выше: _mm512_reduce_add_epi32 даёт ложное предупреждение GCC
+    acc = _mm256_add_epi32(_mm512_maskz_extracti64x4_epi64(0xF, wide, 0),
+                           _mm512_maskz_extracti64x4_epi64(0xF, wide, 1));
+#endif
+    for (; i + 16 <= n; i += 16) {
+        __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)));
+        __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+    sum = _mm_cvtsi128_si32(s);
+#endif
+    for (; i < n; ++i) {
+        sum += int32_t(a[i]) * int32_t(b[i]);
+    }
+    return sum;
+}
+
+// C[m x n] += A[m x k] * B[k x n]
+// обратный проход: ошибки слоя на его веса дают ошибки предыдущего слоя
+template <typename T>
+void gemm_nn(std::size_t m, std::size_t n, std::size_t k, const T *a, std::size_t lda, const T *b, std::size_t ldb,
+             T *c, std::size_t ldc) {
+    for (std::size_t pp = 0; pp < k; pp += block) {
+        std::size_t p_end = std::min(k, pp + block);
+        for (std::size_t i = 0; i < m; ++i) {
+            const T *a_row = a + i * lda;
+            T *c_row = c + i * ldc;
+            vecmat(n, p_end - pp, a_row + pp, b + pp * ldb, ldb, c_row);
+        }
+    }
+}
+
+// C[m x n] = A[m x k] * B[n x k]^T (+ C, если accumulate)
+// прямой проход: активации батча на веса слоя, строки весов - нейроны
+// На больших батчах и широких слоях B транспонируется во временный буфер потока и считается как gemm_nn:
+// строка C набирается в регистрах, без горизонтальной свёртки регистра на каждый элемент C, как у dot.
+// Узкие слои (выходной, 9 нейронов) остаются на dot: строка C короче регистра.
+template <typename T>
+void gemm_nt(std::size_t m, std::size_t n, std::size_t k, const T *a, std::size_t lda, const T *b, std::size_t ldb,
+             T *c, std::size_t ldc, bool accumulate = false) {
+    if (m >= 16 && n >= 16) {
+        thread_local aligned_vector<T> transposed;
+        transposed.resize(k * n);
+        for (std::size_t j = 0; j < n; ++j) {
+            for (std::size_t p = 0; p < k; ++p) {
+                transposed[p * n + j] = b[j * ldb + p];
+            }
+        }
+        if (!accumulate) {
+            for (std::size_t i = 0; i < m; ++i) {
+                std::fill(c + i * ldc, c + i * ldc + n, T(0));
+            }
+        }
+        gemm_nn(m, n, k, a, lda, transposed.data(), n, c, ldc);
+        return;
+    }
+    for (std::size_t jj = 0; jj < n; jj += block) {
+        std::size_t j_end = std::min(n, jj + block);
+        for (std::size_t i = 0; i < m; ++i) {
+            const T *a_row = a + i * lda;
+            T *c_row = c + i * ldc;
+            for (std::size_t j = jj; j < j_end; ++j) {
+                T sum = dot(a_row, b + j * ldb, k);
+                c_row[j] = accumulate ? c_row[j] + sum : sum;
+            }
+        }
+    }
+}
+
+// C[m x n] += A[k x m]^T * B[k x n]
+// градиент весов: сумма по батчу внешних произведений ошибок и входов слоя
+template <typename T>
+void gemm_tn(std::size_t m, std::size_t n, std::size_t k, const T *a, std::size_t lda, const T *b, std::size_t ldb,
+             T *c, std::size_t ldc) {
+    for (std::size_t ii = 0; ii < m; ii += block) {
+        std::size_t i_end = std::min(m, ii + block);
+        for (std::size_t p = 0; p < k; ++p) {
+            const T *a_row = a + p * lda;
+            const T *b_row = b + p * ldb;
+            for (std::size_t i = ii; i < i_end; ++i) {
+                T a_pi = a_row[i];
+                if (a_pi == T(0)) {
+                    continue;
+                }
+                axpy(n, a_pi, b_row, c + i * ldc);
+            }
+        }
+    }
+}
+
+} // namespace nn_kernels
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "dataset.hpp"
+#include "mapped_file.hpp"
+
+// Датасет локальных паттернов 72 -> 9 (local_pattern и get_dataset_from_maze) в виде структуры массивов:
+// 72-битный вход - младшие 64 бита и старший байт, выход - 9 бит в uint16. В отличие от
+// vector<pair<bitset<72>, bitset<9>>> сортировка и удаление повторов идут по целым ключам поразрядно,
+// а файл не зависит от раскладки std::bitset в компиляторе.
+//
+// Формат файла: заголовок 64 байта (магия, версия, 72, 9, размер записи, число записей), затем записи
+// по 11 байт: 9 байт входа и 2 байта выхода, бит k - бит k % 8 байта k / 8, всё little-endian.
+class PatternDataset {
+  public:
+    static constexpr std::size_t Inputs = 72, Outputs = 9;
+    using Sample = std::pair<std::bitset<Inputs>, std::bitset<Outputs>>;
+
+    static constexpr char magic[8] = {'B', 'U', 'G', 'S', 'P', 'A', 'T', 'T'};
+    static constexpr uint32_t version = 1;
+    static constexpr std::size_t header_size = 64, record_size = 11;
+
+    // Входы с несколькими разными выходами: один и тот же паттерн, для которого перебор в разных лабиринтах
+    // нашёл разные лучшие квадраты
+    struct ConflictStats {
+        std::size_t samples = 0;
+        std::size_t unique_inputs = 0;
+        std::size_t conflicting_inputs = 0;  // входы больше чем с одним выходом
+        std::size_t conflicting_samples = 0; // сэмплы с такими входами
+        std::size_t max_labels = 0;          // наибольшее число разных выходов у одного входа
+    };
+
+    PatternDataset() = default;
+    explicit PatternDataset(const std::vector<Sample> &samples) {
+        reserve(samples.size());
+        for (const auto &[input, output] : samples) {
+            add(input, output);
+        }
+    }
+
+    std::size_t size() const { return labels_.size(); }
+    bool empty() const { return labels_.empty(); }
+
+    void reserve(std::size_t n) {
+        low_.reserve(n);
+        high_.reserve(n);
+        labels_.reserve(n);
+    }
+
+    void clear() {
+        low_.clear();
+        high_.clear();
+        labels_.clear();
+        sorted_ = true;
+    }
+
+    void add(uint64_t low, uint8_t high, uint16_t label) {
+        label &= (1u << Outputs) - 1;
+        sorted_ = sorted_ && (empty() || Key(size() - 1) <= std::make_tuple(high, low, label));
+        low_.push_back(low);
+        high_.push_back(high);
+        labels_.push_back(label);
+    }
+
+    void add(const std::bitset<Inputs> &input, const std::bitset<Outputs> &output) {
+        add((input & std::bitset<Inputs>(~uint64_t(0))).to_ullong(), uint8_t((input >> 64).to_ulong()),
+            uint16_t(output.to_ulong()));
+    }
+
+    Sample operator[](std::size_t k) const {
+        std::bitset<Inputs> input = (std::bitset<Inputs>(high_[k]) << 64) | std::bitset<Inputs>(low_[k]);
+        return {input, std::bitset<Outputs>(labels_[k])};
+    }
+
+    // для NeuralNetwork::Train и прочего кода на парах bitset
+    std::vector<Sample> samples() const {
+        std::vector<Sample> result(size());
+        for (std::size_t k = 0; k < size(); ++k) {
+            result[k] = (*this)[k];
+        }
+        return result;
+    }
+
+    const std::vector<uint64_t> &low() const { return low_; }
+    const std::vector<uint8_t> &high() const { return high_; }
+    const std::vector<uint16_t> &labels() const { return labels_; }
+
+    // Сортировка по (вход, выход) поразрядной сортировкой LSD. Запись на время сортировки - 81-битный ключ
+    // label | low << 9 | high << 73 в двух словах, разряды по 11 бит: 8 проходов, счётчики разряда помещаются
+    // в L1. Гистограммы всех разрядов считаются за один проход, разряды, в которых у всех записей одно
+    // значение, пропускаются.
+    void sort() {
+        if (sorted_) {
+            return;
+        }
+        struct Record {
+            uint64_t lo, hi; // биты 0..63 и 64..80 ключа
+        };
+        constexpr std::size_t bits = 11, digits = 8, radix = std::size_t(1) << bits;
+        auto digit = [](const Record &r, std::size_t d) -> std::size_t {
+            std::size_t shift = d * bits;
+            uint64_t v = shift >= 64 ? r.hi >> (shift - 64) : (r.lo >> shift) | (shift ? r.hi << (64 - shift) : 0);
+            return v & (radix - 1);
+        };
+
+        const std::size_t n = size();
+        std::vector<Record> records(n), buffer(n);
+        std::vector<std::size_t> counts(digits * radix, 0);
+        for (std::size_t k = 0; k < n; ++k) {
+            records[k].lo = labels_[k] | (low_[k] << Outputs);
+            records[k].hi = (low_[k] >> (64 - Outputs)) | (uint64_t(high_[k]) << Outputs);
+            for (std::size_t d = 0; d < digits; ++d) {
+                ++counts[d * radix + digit(records[k], d)];
+            }
+        }
+        for (std::size_t d = 0; d < digits; ++d) {
+            std::size_t *offsets = counts.data() + d * radix;
+            if (std::find(offsets, offsets + radix, n) != offsets + radix) {
+                continue;
+            }
+            std::size_t sum = 0;
+            for (std::size_t b = 0; b < radix; ++b) {
+                std::size_t count = offsets[b];
+                offsets[b] = sum;
+                sum += count;
+            }
+            for (const Record &r : records) {
+                buffer[offsets[digit(r, d)]++] = r;
+            }
+            records.swap(buffer);
+        }
+        for (std::size_t k = 0; k < n; ++k) {
+            labels_[k] = uint16_t(records[k].lo & ((1u << Outputs) - 1));
+            low_[k] = (records[k].lo >> Outputs) | (records[k].hi << (64 - Outputs));
+            high_[k] = uint8_t(records[k].hi >> Outputs);
+        }
+        sorted_ = true;
+    }
+
+    // удаляет повторы пар (вход, выход); остаётся отсортированным
+    void dedup() {
+        sort();
+        Compact([&](std::size_t begin, std::size_t end, std::size_t &kept) {
+            for (std::size_t k = begin; k < end; ++k) {
+                if (k == begin || labels_[k] != labels_[k - 1]) {
+                    Move(k, kept++);
+                }
+            }
+        });
+    }
+
+    // Оставляет по одному сэмплу на вход: самый частый выход, при равенстве - меньший.
+    // Конфликты разрешаются большинством, как если бы повторы входа были голосами.
+    void dedup_inputs() {
+        sort();
+        Compact([&](std::size_t begin, std::size_t end, std::size_t &kept) {
+            std::size_t best = begin, best_count = 0;
+            for (std::size_t k = begin; k < end;) {
+                std::size_t run = k;
+                while (run < end && labels_[run] == labels_[k]) {
+                    ++run;
+                }
+                if (run - k > best_count) {
+                    best = k;
+                    best_count = run - k;
+                }
+                k = run;
+            }
+            Move(best, kept++);
+        });
+    }
+
+    // статистика конфликтов; датасет при этом сортируется
+    ConflictStats conflicts() {
+        sort();
+        ConflictStats stats;
+        stats.samples = size();
+        for (std::size_t begin = 0, end; begin < size(); begin = end) {
+            end = InputEnd(begin);
+            std::size_t labels = 1;
+            for (std::size_t k = begin + 1; k < end; ++k) {
+                labels += labels_[k] != labels_[k - 1];
+            }
+            ++stats.unique_inputs;
+            if (labels > 1) {
+                ++stats.conflicting_inputs;
+                stats.conflicting_samples += end - begin;
+            }
+            stats.max_labels = std::max(stats.max_labels, labels);
+        }
+        return stats;
+    }
+
+    bool save(const std::string &filename) const {
+        std::vector<unsigned char> buffer(header_size + size() * record_size, 0);
+        std::memcpy(buffer.data(), magic, sizeof(magic));
+        packed::put_u32(buffer.data() + 8, version);
+        packed::put_u32(buffer.data() + 12, Inputs);
+        packed::put_u32(buffer.data() + 16, Outputs);
+        packed::put_u32(buffer.data() + 20, record_size);
+        packed::put_u64(buffer.data() + 24, size());
+        for (std::size_t k = 0; k < size(); ++k) {
+            unsigned char *record = buffer.data() + header_size + k * record_size;
+            packed::put_u64(record, low_[k]);
+            record[8] = high_[k];
+            packed::put_u16(record + 9, labels_[k]);
+        }
+        std::ofstream file(filename, std::ios::binary);
+        file.write(reinterpret_cast<const char *>(buffer.data()), std::streamsize(buffer.size()));
+        return bool(file);
+    }
+
+    // false и пустой датасет, если файл не в этом формате или обрезан
+    bool load(const std::string &filename) {
+        clear();
+        utils::MappedFile file(filename);
+        const unsigned char *src = file.data();
+        if (!file.is_open() || file.size() < header_size || std::memcmp(src, magic, sizeof(magic)) != 0 ||
+            packed::get_u32(src + 8) != version || packed::get_u32(src + 12) != Inputs ||
+            packed::get_u32(src + 16) != Outputs || packed::get_u32(src + 20) != record_size) {
+            return false;
+        }
+        uint64_t count = packed::get_u64(src + 24);
+        if (count > (file.size() - header_size) / record_size) {
+            return false;
+        }
+        reserve(count);
+        for (std::size_t k = 0; k < count; ++k) {
+            const unsigned char *record = src + header_size + k * record_size;
+            add(packed::get_u64(record), record[8], packed::get_u16(record + 9));
+        }
+        return true;
+    }
+
+  private:
+    // порядок sort(): старший байт входа, младшие биты входа, выход
+    std::tuple<uint8_t, uint64_t, uint16_t> Key(std::size_t k) const { return {high_[k], low_[k], labels_[k]}; }
+
+    // конец серии записей с тем же входом, что у begin
+    std::size_t InputEnd(std::size_t begin) const {
+        std::size_t end = begin + 1;
+        while (end < size() && low_[end] == low_[begin] && high_[end] == high_[begin]) {
+            ++end;
+        }
+        return end;
+    }
+
+    void Move(std::size_t from, std::size_t to) {
+        low_[to] = low_[from];
+        high_[to] = high_[from];
+        labels_[to] = labels_[from];
+    }
+
+    // keep(begin, end, kept) для каждой серии одного входа переносит оставляемые записи на место kept
+    template <typename Keep>
+    void Compact(Keep &&keep) {
+        std::size_t kept = 0;
+        for (std::size_t begin = 0, end; begin < size(); begin = end) {
+            end = InputEnd(begin);
+            keep(begin, end, kept);
+        }
+        low_.resize(kept);
+        high_.resize(kept);
+        labels_.resize(kept);
+    }
+
+    std::vector<uint64_t> low_;
+    std::vector<uint8_t> high_;
+    std::vector<uint16_t> labels_;
+    bool sorted_ = true; // записи уже в порядке sort()
+};
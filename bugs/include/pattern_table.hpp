@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "pattern_dataset.hpp"
+
+// Таблица известных паттернов 72 -> 9: открытая адресация с линейным пробированием по 72-битному входу,
+// заполнение не больше половины, поэтому поиск - один-два промаха кэша вместо прямого прохода сети.
+// Строится из PatternDataset; если у входа в датасете несколько выходов, берётся самый частый (dedup_inputs).
+class PatternTable {
+  public:
+    PatternTable() = default;
+
+    explicit PatternTable(PatternDataset dataset) {
+        dataset.dedup_inputs();
+        std::size_t capacity = 16;
+        while (capacity < 2 * dataset.size()) {
+            capacity *= 2;
+        }
+        mask_ = capacity - 1;
+        low_.assign(capacity, 0);
+        high_.assign(capacity, 0);
+        labels_.assign(capacity, empty);
+        for (std::size_t k = 0; k < dataset.size(); ++k) {
+            std::size_t slot = Hash(dataset.low()[k], dataset.high()[k]);
+            while (labels_[slot] != empty) {
+                slot = (slot + 1) & mask_;
+            }
+            low_[slot] = dataset.low()[k];
+            high_[slot] = dataset.high()[k];
+            labels_[slot] = dataset.labels()[k];
+        }
+        size_ = dataset.size();
+    }
+
+    std::size_t size() const { return size_; }
+
+    std::optional<std::bitset<PatternDataset::Outputs>> find(const std::bitset<PatternDataset::Inputs> &input) const {
+        if (size_ == 0) {
+            return std::nullopt;
+        }
+        uint64_t low = (input & std::bitset<PatternDataset::Inputs>(~uint64_t(0))).to_ullong();
+        uint8_t high = uint8_t((input >> 64).to_ulong());
+        for (std::size_t slot = Hash(low, high); labels_[slot] != empty; slot = (slot + 1) & mask_) {
+            if (low_[slot] == low && high_[slot] == high) {
+                return std::bitset<PatternDataset::Outputs>(labels_[slot]);
+            }
+        }
+        return std::nullopt;
+    }
+
+  private:
+    static constexpr uint16_t empty = 0xFFFF; // выходы 9-битные, такой метки не бывает
+
+    std::size_t Hash(uint64_t low, uint8_t high) const {
+        uint64_t h = (low ^ (uint64_t(high) << 56 | uint64_t(high))) * 0x9E3779B97F4A7C15ULL;
+        return std::size_t(h ^ (h >> 29)) & mask_;
+    }
+
+    std::size_t size_ = 0, mask_ = 0;
+    std::vector<uint64_t> low_;
+    std::vector<uint8_t> high_;
+    std::vector<uint16_t> labels_;
+};
+
+// Попадания в таблицу одного потока; общий счётчик на все потоки стал бы горячей кэш-линией, поэтому
+// у каждого свои, а при выводе статистики они складываются
+struct LookupStats {
+    uint64_t hits = 0, misses = 0;
+
+    LookupStats &operator+=(const LookupStats &o) {
+        hits += o.hits;
+        misses += o.misses;
+        return *this;
+    }
+
+    // доля запросов, на которые ответила таблица
+    double hit_rate() const {
+        uint64_t total = hits + misses;
+        return total ? double(hits) / total : 0.0;
+    }
+};
+
+// Вывод через таблицу с откатом на сеть для неизвестных паттернов. Net - NeuralNetwork<72, ..., 9, ...>,
+// сеть и таблица не копируются и должны жить дольше. Сам объект не меняется, поэтому его можно звать
+// из нескольких потоков, если у каждого свои Workspace и LookupStats.
+template <typename Net>
+class PatternLookup {
+  public:
+    using Scalar = typename Net::ScalarType;
+
+    PatternLookup(const PatternTable &table, const Net &net) : table_(table), net_(net) {}
+
+    // stats - необязательные счётчики попаданий вызывающего потока
+    std::bitset<Net::Outputs> Apply(const std::bitset<Net::Inputs> &input, LookupStats *stats = nullptr) const {
+        auto known = table_.find(input);
+        if (stats) {
+            ++(known ? stats->hits : stats->misses);
+        }
+        return known ? *known : net_.Apply(input);
+    }
+
+    // буферы батча, переиспользуются между вызовами
+    struct Workspace {
+        LookupStats stats; // попадания всех батчей с этим буфером
+        typename Net::BatchWorkspace net;
+        std::vector<std::bitset<Net::Inputs>> misses; // входы, которых нет в таблице
+        std::vector<std::size_t> index;               // их номера в батче
+        std::vector<Scalar> probabilities;            // выходы сети для них
+    };
+
+    // Как Net::ApplyBatch: известным паттернам пишутся вероятности 0 и 1 из таблицы, остальные идут в сеть
+    // одним батчем.
+    void ApplyBatch(const std::bitset<Net::Inputs> *inputs, std::size_t count, Scalar *probabilities,
+                    Workspace &ws) const {
+        ws.misses.clear();
+        ws.index.clear();
+        for (std::size_t b = 0; b < count; ++b) {
+            if (auto known = table_.find(inputs[b])) {
+                for (std::size_t o = 0; o < Net::Outputs; ++o) {
+                    probabilities[b * Net::Outputs + o] = (*known)[o] ? Scalar(1) : Scalar(0);
+                }
+            } else {
+                ws.misses.push_back(inputs[b]);
+                ws.index.push_back(b);
+            }
+        }
+        ws.stats.hits += count - ws.misses.size();
+        ws.stats.misses += ws.misses.size();
+        if (ws.misses.empty()) {
+            return;
+        }
+        ws.probabilities.resize(ws.misses.size() * Net::Outputs);
+        net_.ApplyBatch(ws.misses.data(), ws.misses.size(), ws.probabilities.data(), ws.net);
+        for (std::size_t m = 0; m < ws.misses.size(); ++m) {
+            const Scalar *row = ws.probabilities.data() + m * Net::Outputs;
+            std::copy(row, row + Net::Outputs, probabilities + ws.index[m] * Net::Outputs);
+        }
+    }
+
+  private:
+    const PatternTable &table_;
+    const Net &net_;
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "nn.hpp"
+#include "thread_pool.hpp"
+
+struct PopulationOptions {
+    std::size_t population = 8;
+    std::size_t steps_per_round = 100; // мини-батчей на участника между отборами
+    TrainOptions train;                // batch_size и оптимизатор; pool и validation_fraction не используются
+
+    // начальные гиперпараметры - лог-равномерно в диапазонах
+    double learning_rate_min = 0.01, learning_rate_max = 1.0;
+    double l2_min = 1e-6, l2_max = 1e-3;
+
+    double exploit_fraction = 0.25; // худшая доля заменяется копиями лучшей доли
+    double perturb = 1.2;           // explore: гиперпараметры копии умножаются на perturb или 1 / perturb
+    unsigned seed = 0;
+};
+
+// Population-based training: участники обучаются параллельно на постоянном пуле, каждый со своими
+// скоростью и L2. После каждого раунда из steps_per_round шагов все оцениваются на общей валидации,
+// худшие получают веса случайного из лучших и его гиперпараметры с возмущением.
+// В отличие от перезапусков от лучшей сети, результаты остальных не выбрасываются, а потоки не пересоздаются.
+// Net - NeuralNetwork.
+template <typename Net>
+class PopulationTrainer {
+  public:
+    using Sample = typename Net::Sample;
+
+    struct Member {
+        Net net;
+        double learning_rate = 0;
+        double l2_lambda = 0;
+        double validation_error = 0; // после последнего раунда
+        std::size_t position = 0;    // следующий сэмпл обучающей выборки
+        std::size_t steps = 0;       // шагов с начала обучения этой сети, включая шаги предков
+    };
+
+    // Обучающая выборка перемешивается один раз; участники идут по ней с разных мест подряд идущими батчами.
+    PopulationTrainer(std::vector<Sample> train, std::vector<Sample> validation, const PopulationOptions &options,
+                      ThreadPool &pool)
+        : train_(std::move(train)), validation_(std::move(validation)), options_(options), pool_(pool),
+          gen_(options.seed) {
+        std::shuffle(train_.begin(), train_.end(), gen_);
+        auto log_uniform = [&](double lo, double hi) {
+            return std::exp(std::uniform_real_distribution<double>(std::log(lo), std::log(hi))(gen_));
+        };
+        for (std::size_t k = 0; k < options_.population; ++k) {
+            Member member{Net(unsigned(gen_()))};
+            member.learning_rate = log_uniform(options_.learning_rate_min, options_.learning_rate_max);
+            member.l2_lambda = log_uniform(options_.l2_min, options_.l2_max);
+            member.position = train_.empty() ? 0 : gen_() % train_.size();
+            member.net.SetOptimizer(options_.train);
+            members_.push_back(std::move(member));
+        }
+    }
+
+    // Раунд: обучение и оценка всех участников параллельно, затем exploit/explore.
+    // Возвращает ошибку лучшего на валидации до замены худших.
+    double Round() {
+        pool_.run(members_.size(), [&](std::size_t k) {
+            Member &member = members_[k];
+            Step(member);
+            member.validation_error = member.net.Error(validation_);
+        });
+        ++rounds_;
+
+        std::vector<std::size_t> order = Ranking();
+        double best_error = members_[order.front()].validation_error;
+        best_ = members_[order.front()].net;
+
+        std::size_t population = members_.size();
+        std::size_t replaced = std::min(std::size_t(options_.exploit_fraction * population), population / 2);
+        for (std::size_t r = 0; r < replaced; ++r) {
+            const Member &source = members_[order[gen_() % replaced]];
+            Member &target = members_[order[population - 1 - r]];
+            target.net = source.net;
+            target.net.ResetOptimizerState();
+            target.learning_rate = source.learning_rate * Perturbation();
+            target.l2_lambda = source.l2_lambda * Perturbation();
+            target.validation_error = source.validation_error;
+            target.steps = source.steps;
+        }
+        return best_error;
+    }
+
+    // лучшая сеть последнего раунда; до первого раунда - пусто
+    const std::optional<Net> &best() const { return best_; }
+    const std::vector<Member> &members() const { return members_; }
+    std::size_t rounds() const { return rounds_; }
+
+  private:
+    void Step(Member &member) {
+        if (train_.empty()) {
+            return;
+        }
+        std::size_t batch_size = std::clamp<std::size_t>(options_.train.batch_size, 1, train_.size());
+        for (std::size_t s = 0; s < options_.steps_per_round; ++s) {
+            if (member.position + batch_size > train_.size()) {
+                member.position = 0;
+            }
+            member.net.TrainBatch(train_.data() + member.position, batch_size, member.learning_rate,
+                                  member.l2_lambda);
+            member.position += batch_size;
+        }
+        member.steps += options_.steps_per_round;
+    }
+
+    // индексы участников от лучшего к худшему
+    std::vector<std::size_t> Ranking() const {
+        std::vector<std::size_t> order(members_.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+            return members_[a].validation_error < members_[b].validation_error;
+        });
+        return order;
+    }
+
+    double Perturbation() { return gen_() % 2 ? options_.perturb : 1 / options_.perturb; }
+
+    std::vector<Sample> train_;
+    std::vector<Sample> validation_;
+    PopulationOptions options_;
+    ThreadPool &pool_;
+    std::mt19937 gen_;
+
+    std::vector<Member> members_;
+    std::optional<Net> best_;
+    std::size_t rounds_ = 0;
+};
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "activations.hpp"
+#include "nn.hpp"
+#include "nn_kernels.hpp"
+
+// Квантованная копия обученной NeuralNetwork только для прямого прохода.
+// Веса - int8 с масштабом на каждый нейрон (строку), смещения - float. Активации скрытых слоёв квантуются
+// в int8 на лету со своим масштабом на вектор, скалярные произведения считаются в int32 (nn_kernels::dot_i8),
+// сигмоида - по таблице (TableSigmoid).
+// Первый слой для бинарного входа - сумма int8 столбцов установленных битов, как InputLayer у NeuralNetwork.
+// Для 72-3x24-9 все веса занимают около 6 КБ и помещаются в L1 рядом с лабиринтом.
+template <std::size_t InputNeurons, std::size_t HiddenLayers, std::size_t HiddenNeurons, std::size_t OutputNeurons,
+          ActivationFunction AF>
+class QuantizedNetwork {
+  public:
+    static constexpr std::size_t HiddenStride = nn_kernels::padded<int8_t>(HiddenNeurons);
+
+    using Row = std::array<int8_t, HiddenStride>;
+
+    template <typename Scalar, typename SigmoidPolicy>
+    explicit QuantizedNetwork(
+        const NeuralNetwork<InputNeurons, HiddenLayers, HiddenNeurons, OutputNeurons, AF, Scalar, SigmoidPolicy> &net) {
+        // первый слой: масштаб общий для всех входов нейрона i, иначе столбцы нельзя складывать в целых
+        for (std::size_t i = 0; i < HiddenNeurons; ++i) {
+            float max_abs = 0;
+            for (std::size_t j = 0; j < InputNeurons; ++j) {
+                max_abs = std::max(max_abs, std::abs(float(net.weights_input_hidden_[j][i])));
+            }
+            input_scale_[i] = max_abs > 0 ? max_abs / 127 : 1.f;
+            for (std::size_t j = 0; j < InputNeurons; ++j) {
+                weights_input_hidden_[j][i] = Quantize(float(net.weights_input_hidden_[j][i]), input_scale_[i]);
+            }
+            bias_hidden_[i] = float(net.bias_hidden_[i]);
+        }
+
+        for (std::size_t h = 0; h + 1 < HiddenLayers; ++h) {
+            for (std::size_t i = 0; i < HiddenNeurons; ++i) {
+                hidden_scale_[h][i] =
+                    QuantizeRow(net.weights_hidden_hidden_[h][i].data(), weights_hidden_hidden_[h][i]);
+            }
+        }
+
+        for (std::size_t i = 0; i < OutputNeurons; ++i) {
+            output_scale_[i] = QuantizeRow(net.weights_hidden_output_[i].data(), weights_hidden_output_[i]);
+            bias_output_[i] = float(net.bias_output_[i]);
+        }
+    }
+
+    // вероятности выходов, OutputNeurons чисел
+    void Probabilities(const std::bitset<InputNeurons> &input, float *probabilities) const {
+        std::array<float, OutputNeurons> output_input;
+        Forward(input, output_input);
+        for (std::size_t i = 0; i < OutputNeurons; ++i) {
+            probabilities[i] = TableSigmoid::apply(output_input[i]);
+        }
+    }
+
+    std::bitset<OutputNeurons> Apply(const std::bitset<InputNeurons> &input) const {
+        std::array<float, OutputNeurons> output_input;
+        Forward(input, output_input);
+        std::bitset<OutputNeurons> output;
+        for (std::size_t i = 0; i < OutputNeurons; ++i) {
+            output[i] = output_input[i] > 0; // сигмоида > 0.5
+        }
+        return output;
+    }
+
+    double Score(const std::vector<std::pair<std::bitset<InputNeurons>, std::bitset<OutputNeurons>>> &dataset) const {
+        double correct = 0.0;
+        for (const auto &[input, target] : dataset) {
+            correct += Apply(input) == target;
+        }
+        return correct / dataset.size();
+    }
+
+  private:
+    // округление до ближайшего без вызова lround: квантование активаций стоит на горячем пути
+    static int8_t Quantize(float w, float scale) {
+        float q = std::clamp(w / scale, -127.f, 127.f);
+        return int8_t(int(q + (q >= 0 ? 0.5f : -0.5f)));
+    }
+
+    // строка весов -> int8 с масштабом max|w| / 127, дополнение остаётся нулевым
+    template <typename Scalar>
+    static float QuantizeRow(const Scalar *weights, Row &row) {
+        float max_abs = 0;
+        for (std::size_t j = 0; j < HiddenNeurons; ++j) {
+            max_abs = std::max(max_abs, std::abs(float(weights[j])));
+        }
+        float scale = max_abs > 0 ? max_abs / 127 : 1.f;
+        row.fill(0);
+        for (std::size_t j = 0; j < HiddenNeurons; ++j) {
+            row[j] = Quantize(float(weights[j]), scale);
+        }
+        return scale;
+    }
+
+    static float Activate(float x) {
+        if constexpr (AF == ActivationFunction::Sigmoid) {
+            return TableSigmoid::apply(x);
+        } else {
+            return x > 0 ? x : 0.01f * x;
+        }
+    }
+
+    // активации -> int8 с общим масштабом вектора, возвращает масштаб
+    static float QuantizeActivations(const std::array<float, HiddenNeurons> &values, Row &out) {
+        float max_abs = 0;
+        for (float v : values) {
+            max_abs = std::max(max_abs, std::abs(v));
+        }
+        float scale = max_abs > 0 ? max_abs / 127 : 1.f;
+        for (std::size_t i = 0; i < HiddenNeurons; ++i) {
+            out[i] = Quantize(values[i], scale);
+        }
+        return scale;
+    }
+
+    // суммы выходного слоя до сигмоиды
+    void Forward(const std::bitset<InputNeurons> &input, std::array<float, OutputNeurons> &output_input) const {
+        std::array<int32_t, HiddenNeurons> acc{};
+        ForEachSetBit(input, [&](std::size_t j) {
+            const Row &column = weights_input_hidden_[j];
+            for (std::size_t i = 0; i < HiddenNeurons; ++i) {
+                acc[i] += column[i];
+            }
+        });
+
+        std::array<float, HiddenNeurons> hidden;
+        for (std::size_t i = 0; i < HiddenNeurons; ++i) {
+            hidden[i] = Activate(float(acc[i]) * input_scale_[i] + bias_hidden_[i]);
+        }
+
+        alignas(nn_kernels::alignment) Row quantized{};
+        for (std::size_t h = 0; h + 1 < HiddenLayers; ++h) {
+            float scale = QuantizeActivations(hidden, quantized);
+            for (std::size_t i = 0; i < HiddenNeurons; ++i) {
+                int32_t dot = nn_kernels::dot_i8(weights_hidden_hidden_[h][i].data(), quantized.data(), HiddenStride);
+                hidden[i] = Activate(float(dot) * hidden_scale_[h][i] * scale + bias_hidden_[i]);
+            }
+        }
+
+        float scale = QuantizeActivations(hidden, quantized);
+        for (std::size_t i = 0; i < OutputNeurons; ++i) {
+            int32_t dot = nn_kernels::dot_i8(weights_hidden_output_[i].data(), quantized.data(), HiddenStride);
+            output_input[i] = float(dot) * output_scale_[i] * scale + bias_output_[i];
+        }
+    }
+
+    alignas(nn_kernels::alignment) std::array<Row, InputNeurons> weights_input_hidden_{};
+    alignas(nn_kernels::alignment)
+        std::array<std::array<Row, HiddenNeurons>, HiddenLayers - 1> weights_hidden_hidden_{};
+    alignas(nn_kernels::alignment) std::array<Row, OutputNeurons> weights_hidden_output_{};
+    std::array<float, HiddenNeurons> input_scale_{};
+    std::array<std::array<float, HiddenNeurons>, HiddenLayers - 1> hidden_scale_{};
+    std::array<float, OutputNeurons> output_scale_{};
+    std::array<float, HiddenNeurons> bias_hidden_{};
+    std::array<float, OutputNeurons> bias_output_{};
+};
+
+// Проверка точности квантования на отложенной выборке
+struct QuantizationReport {
+    double float_score = 0;     // Score исходной сети
+    double quantized_score = 0; // Score квантованной
+    double agreement = 0;       // доля сэмплов, где ответы обеих сетей совпали полностью
+};
+
+template <typename Net, typename QuantizedNet, std::size_t In, std::size_t Out>
+QuantizationReport CheckQuantization(const Net &net, const QuantizedNet &quantized,
+                                     const std::vector<std::pair<std::bitset<In>, std::bitset<Out>>> &held_out) {
+    QuantizationReport report;
+    if (held_out.empty()) {
+        return report;
+    }
+    report.float_score = net.Score(held_out);
+    report.quantized_score = quantized.Score(held_out);
+    std::size_t same = 0;
+    for (const auto &sample : held_out) {
+        same += net.Apply(sample.first) == quantized.Apply(sample.first);
+    }
+    report.agreement = double(same) / held_out.size();
+    return report;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "hashing.hpp"
+
+namespace utils {
+
+// Результат оценки лабиринта в hill climb: проходимость и число шагов pass_maze (0 для непроходимого)
+struct MazeScore {
+    size_t score = 0;
+    bool solvable = false;
+};
+
+// Общий для всех воркеров кэш оценок лабиринтов фиксированного размера, без блокировок. Ключ - zobrist_key
+// расположения стен (MutationManager::get_key).
+// Таблица с прямой адресацией и вытеснением: новая запись затирает старую в своём слоте. Слот - два атомарных
+// слова, данные и key ^ данные; запись из двух store может перемешаться с чужой, но тогда при чтении не сойдётся
+// ключ и это будет обычный промах (схема Hyatt'а из шахматных транспозиционных таблиц).
+// Счётчиков попаданий у кэша нет: общий атомик стал бы горячей кэш-линией для всех воркеров, попадания считает
+// вызывающий код в своих WorkerCounters.
+class ScoreCache {
+  public:
+    // capacity округляется вверх до степени двойки, слот - 16 байт
+    explicit ScoreCache(size_t capacity = size_t(1) << 20) {
+        size_t size = 1;
+        while (size < capacity) {
+            size *= 2;
+        }
+        mask_ = size - 1;
+        slots_.reset(new Slot[size]);
+    }
+
+    ScoreCache(const ScoreCache &) = delete;
+    ScoreCache &operator=(const ScoreCache &) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    bool find(uint64_t key, MazeScore &result) const {
+        const Slot &slot = slots_[Index(key)];
+        uint64_t data = slot.data.load(std::memory_order_relaxed);
+        uint64_t check = slot.check.load(std::memory_order_relaxed);
+        if (!(data & valid) || (check ^ data) != key) {
+            return false;
+        }
+        result.score = size_t(data >> 2);
+        result.solvable = data & solvable_bit;
+        return true;
+    }
+
+    void insert(uint64_t key, const MazeScore &value) {
+        Slot &slot = slots_[Index(key)];
+        uint64_t data = uint64_t(value.score) << 2 | (value.solvable ? solvable_bit : 0) | valid;
+        slot.check.store(key ^ data, std::memory_order_relaxed);
+        slot.data.store(data, std::memory_order_relaxed);
+    }
+
+    // не потокобезопасно относительно find/insert
+    void clear() {
+        for (size_t i = 0; i <= mask_; i++) {
+            slots_[i].check.store(0, std::memory_order_relaxed);
+            slots_[i].data.store(0, std::memory_order_relaxed);
+        }
+    }
+
+  private:
+    static constexpr uint64_t valid = 1, solvable_bit = 2; // младшие биты данных, дальше счёт
+
+    struct alignas(16) Slot {
+        std::atomic<uint64_t> check{0}, data{0};
+    };
+
+    // ключ перемешивается ещё раз, чтобы индекс не зависел от качества младших битов ключа
+    size_t Index(uint64_t key) const { return size_t(fmix64(key)) & mask_; }
+
+    size_t mask_ = 0;
+    std::unique_ptr<Slot[]> slots_;
+};
+
+} // namespace utils
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Постоянный пул потоков для параллельных циклов.
+// Потоки создаются один раз, run() раздаёт индексы задач свободным потокам и ждёт завершения всех.
+// run() нельзя вызывать из задачи того же пула.
+class ThreadPool {
+  public:
+    explicit ThreadPool(std::size_t num_threads = std::thread::hardware_concurrency()) {
+        if (num_threads == 0) {
+            num_threads = 1;
+        }
+        for (std::size_t i = 0; i < num_threads; i++) {
+            threads.push_back(std::thread([this]() { worker(); }));
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+        }
+        work_cv.notify_all();
+        for (auto &t : threads) {
+            t.join();
+        }
+    }
+
+    std::size_t size() const { return threads.size(); }
+
+    // task(i) для всех i из [0, count), возвращается после завершения всех задач
+    void run(std::size_t count, const std::function<void(std::size_t)> &task) {
+        if (count == 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> serial(run_mtx); // run() из разных потоков выполняются по очереди
+        std::unique_lock<std::mutex> state(mtx);
+        current = &task;
+        total = count;
+        next = 0;
+        remaining = count;
+        work_cv.notify_all();
+        done_cv.wait(state, [this]() { return remaining == 0; });
+        current = nullptr;
+    }
+
+  private:
+    void worker() {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (true) {
+            work_cv.wait(lock, [this]() { return stop || (current && next < total); });
+            if (stop) {
+                return;
+            }
+            std::size_t index = next++;
+            const auto *task = current;
+            lock.unlock();
+            (*task)(index);
+            lock.lock();
+            if (--remaining == 0) {
+                done_cv.notify_all();
+            }
+        }
+    }
+
+    std::vector<std::thread> threads;
+    std::mutex run_mtx;
+    std::mutex mtx;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+    const std::function<void(std::size_t)> *current = nullptr;
+    std::size_t total = 0, next = 0, remaining = 0;
+    bool stop = false;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <ostream>
+
+// Метрики одной эпохи обучения NeuralNetwork, MLP и ConvNet
+struct EpochMetrics {
+    std::size_t epoch = 0;
+    double train_error = 0;
+    double validation_error = 0; // 0, если валидации нет
+    double learning_rate = 0;
+    double elapsed_seconds = 0;    // с начала Train
+    double samples_per_second = 0; // на этой эпохе
+};
+
+// Получатель метрик, вызывается после каждой эпохи в потоке, который вызвал Train. Пустой - обучение
+// ничего не выводит; так по умолчанию, чтобы вывод не тормозил обучение и не перемешивался между потоками.
+using EpochCallback = std::function<void(const EpochMetrics &)>;
+
+// Эпохи в текстовом виде по прежнему расписанию: первые 10, затем каждая 10-я до 100, каждая 100-я до 1000
+// и каждая 1000-я. Строки заканчиваются '\n' без сброса потока.
+class ConsoleSink {
+  public:
+    explicit ConsoleSink(std::ostream &out = std::cout) : out(&out) {}
+
+    void operator()(const EpochMetrics &m) const {
+        std::size_t e = m.epoch;
+        if (e < 10 || (e < 100 && e % 10 == 0) || (e < 1000 && e % 100 == 0) || e % 1000 == 0) {
+            *out << "Epoch " << e << ": error = " << m.train_error;
+            if (m.validation_error > 0) {
+                *out << ", validation error = " << m.validation_error;
+            }
+            *out << ", learning rate = " << m.learning_rate << ", " << m.samples_per_second << " samples/s\n";
+        }
+    }
+
+  private:
+    std::ostream *out;
+};
+
+// Все эпохи в CSV, заголовок пишется при создании. Поток не сбрасывается: буфер файла сбрасывается сам
+// или при закрытии.
+class CsvSink {
+  public:
+    explicit CsvSink(std::ostream &out) : out(&out) {
+        *this->out << "epoch,train_error,validation_error,learning_rate,elapsed_seconds,samples_per_second\n";
+    }
+
+    void operator()(const EpochMetrics &m) const {
+        *out << m.epoch << ',' << m.train_error << ',' << m.validation_error << ',' << m.learning_rate << ','
+             << m.elapsed_seconds << ',' << m.samples_per_second << '\n';
+    }
+
+  private:
+    std::ostream *out;
+};
+
+// Замер времени для EpochMetrics: begin() в начале эпохи, finish() в конце
+class EpochTimer {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    void begin() { epoch_start = clock::now(); }
+
+    EpochMetrics finish(std::size_t epoch, double train_error, double learning_rate, std::size_t samples) const {
+        auto now = clock::now();
+        double epoch_seconds = std::chrono::duration<double>(now - epoch_start).count();
+        EpochMetrics m;
+        m.epoch = epoch;
+        m.train_error = train_error;
+        m.learning_rate = learning_rate;
+        m.elapsed_seconds = std::chrono::duration<double>(now - start).count();
+        m.samples_per_second = epoch_seconds > 0 ? samples / epoch_seconds : 0;
+        return m;
+    }
+
+  private:
+    clock::time_point start = clock::now(), epoch_start = start;
+};
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <atomic>
 #include <bitset>
 #include <condition_variable>
 #include <cstddef>
@@ -6,7 +7,9 @@
 #include <fstream>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <queue>
 #include <string>
 #include <thread>
@@ -15,9 +18,15 @@
 #include <vector>
 
 #include <cassert>
+#include <dataset.hpp>
+#include <generator_stats.hpp>
+#include <maze_evolver.hpp>
 #include <maze_utils.hpp>
+#include <mlp.hpp>
 #include <nn.hpp>
 #include <researcher.hpp>
+#include <score_cache.hpp>
+#include <thread_pool.hpp>
 
 using namespace utils;
 
@@ -31,191 +40,12 @@ std::string back_string() {
     return s;
 }
 
-template <size_t size>
-std::string to_string(const std::bitset<size> &b) {
-    return b.to_string();
-}
-
-template <size_t size>
-std::bitset<size> from_string(const std::string &s) {
-    return std::bitset<size>(s);
-}
-
-template <size_t size>
-std::string to_csv(const std::bitset<size> &b) {
-    std::string s;
-    for (size_t i = 0; i < size; i++) {
-        s += b[i] ? "1" : "0";
-        if (i < size - 1) {
-            s += ",";
-        }
-    }
-    return s;
-}
-
-// compact float to string
-std::string to_string(float f) {
-    std::stringstream ss;
-    ss << std::fixed << std::setprecision(4) << f;
-    // strip trailing zeros
-    std::string s = ss.str();
-    s.erase(s.find_last_not_of('0') + 1, std::string::npos);
-    // strip trailing point
-    if (s.back() == '.') {
-        s.pop_back();
-    }
-    return s;
-}
-
-template <typename T>
-std::string to_string(const std::vector<T> &v) {
-    std::string s;
-    for (const auto &e : v) {
-        s += to_string(e) + " ";
-    }
-    return s;
-}
-
-template <typename T>
-T from_string(const std::string &s) {
-    T v;
-    std::istringstream iss(s);
-    std::remove_reference_t<decltype(v[0])> e;
-    while (iss >> e) {
-        v.push_back(e);
-    }
-    return v;
-}
-
-template <typename T>
-std::string to_csv(const std::vector<T> &v) {
-    std::string s;
-    for (size_t i = 0; i < v.size(); i++) {
-        s += std::to_string(v[i]);
-        if (i < v.size() - 1) {
-            s += ",";
-        }
-    }
-    return s;
-}
-
-template <typename T_IN, typename T_OUT>
-class Dataset {
-  public:
-    std::vector<std::pair<T_IN, T_OUT>> data;
-    Dataset() = default;
-    Dataset(const std::vector<std::pair<T_IN, T_OUT>> &data) : data(data) {}
-    Dataset(const Dataset<T_IN, T_OUT> &d) : data(d.data) {}
-    Dataset<T_IN, T_OUT> &operator=(const Dataset<T_IN, T_OUT> &d) {
-        data = d.data;
-        return *this;
-    }
-    void add(const T_IN &input, const T_OUT &output) { data.push_back(std::make_pair(input, output)); }
-    void add(const std::pair<T_IN, T_OUT> &p) { data.push_back(p); }
-    void clear() { data.clear(); }
-    size_t size() const { return data.size(); }
-    std::pair<T_IN, T_OUT> &operator[](size_t index) { return data[index]; }
-    const std::pair<T_IN, T_OUT> &operator[](size_t index) const { return data[index]; }
-    void shuffle() { std::shuffle(data.begin(), data.end(), std::mt19937(std::random_device()())); }
-    void unique() {
-        std::sort(data.begin(), data.end(),
-                  [](const auto &a, const auto &b) { return to_string(a.first) < to_string(b.first); });
-        data.erase(std::unique(data.begin(), data.end(),
-                               [](const auto &a, const auto &b) { return to_string(a.first) == to_string(b.first); }),
-                   data.end());
-        shuffle();
-    }
-    bool write_to_file(const std::string &filename) {
-        std::ofstream file(filename, std::ios::binary);
-        if (!file.is_open()) {
-            return false;
-        }
-
-        file << sizeof(T_IN) << " " << sizeof(T_OUT) << " " << data.size() << std::endl;
-
-        for (const auto &d : data) {
-            file << to_string(d.first) << std::endl;
-            file << to_string(d.second) << std::endl;
-        }
-
-        file.close();
-        return true;
-    }
-
-    bool read_from_file(const std::string &filename) {
-        std::ifstream file(filename, std::ios::binary);
-        if (!file.is_open()) {
-            return false;
-        }
-
-        size_t size;
-        size_t size_in, size_out;
-
-        file >> size_in >> size_out >> size;
-
-        if (size_in != sizeof(T_IN) || size_out != sizeof(T_OUT)) {
-            return false;
-        }
-
-        data.reserve(data.size() + size);
-
-        for (size_t i = 0; i < size; i++) {
-            std::string in;
-            std::string out;
-
-            std::getline(file, in);
-            std::getline(file, in);
-
-            T_IN input = from_string<T_IN>(in);
-            T_OUT output = from_string<T_OUT>(out);
-
-            data.push_back(std::make_pair(input, output));
-        }
-
-        file.close();
-
-        return true;
-    }
-
-    bool operator==(const Dataset<T_IN, T_OUT> &d) const {
-        if (data.size() != d.data.size()) {
-            return false;
-        }
-
-        for (size_t i = 0; i < data.size(); i++) {
-            if (data[i].first != d.data[i].first || data[i].second != d.data[i].second) {
-                return false;
-            }
-        }
-
-        return true;
-    }
-
-    bool operator!=(const Dataset<T_IN, T_OUT> &d) const { return !(*this == d); }
-
-    bool save_as_csv(const std::string &filename) {
-        std::ofstream file(filename);
-        if (!file.is_open()) {
-            return false;
-        }
-
-        for (auto &d : data) {
-            file << to_csv(d.first) << "," << to_csv(d.second) << std::endl;
-        }
-
-        file.close();
-
-        return true;
-    }
-
-    void insert(const Dataset<T_IN, T_OUT> &d) { data.insert(data.end(), d.data.begin(), d.data.end()); }
-};
-
-// using Dataset = std::vector<std::pair<std::bitset<72>, std::bitset<9>>>;
+// stats - необязательные счётчики воркера генератора
+std::pair<std::vector<float>, std::vector<float>> get_sample(maze<21, 31> m, int x, int y,
+                                                             WorkerCounters *stats = nullptr) {
+    ScopedTimer timer(stats ? &stats->labelling_ns : nullptr);
+    size_t pass_maze_calls = 1, unsolvable = 0; // копим локально, в счётчики пишем один раз в конце
 
-using DS = Dataset<std::vector<float>, std::vector<float>>;
-
-std::pair<std::vector<float>, std::vector<float>> get_sample(maze<21, 31> m, int x, int y) {
     clean_maze<21, 31>(m);
     size_t start_score = pass_maze<21, 31>(m);
     std::vector<float> input;
@@ -289,12 +119,14 @@ std::pair<std::vector<float>, std::vector<float>> get_sample(maze<21, 31> m, int
     for (int c = 0; c < 512; c++) {
 
         if (!is_solvable<21, 31>(m)) {
+            unsolvable++;
             iterate_square();
             continue;
         }
 
         size_t current_score = pass_maze<21, 31>(m);
         clean_maze<21, 31>(m);
+        pass_maze_calls++;
 
         if (current_score > best_score) {
             best_score = current_score;
@@ -319,6 +151,12 @@ std::pair<std::vector<float>, std::vector<float>> get_sample(maze<21, 31> m, int
     assert(input.size() == 21 * 31 * 3); // 1953 элемента на входе
     assert(output.size() == 9);          // 9 элементов на выходе
 
+    if (stats) {
+        WorkerCounters::add(stats->pass_maze_calls, pass_maze_calls);
+        WorkerCounters::add(stats->unsolvable, unsolvable);
+        WorkerCounters::add(stats->samples);
+    }
+
     return std::make_pair(input, output);
 }
 
@@ -334,62 +172,105 @@ bool check_sampler(int num_samples) {
     return true;
 }
 
-DS get_dataset_from_search(size_t size, int num_updates) {
-    DS dataset;
-    maze<21, 31> m;
-    prepare_maze<21, 31>(m);
-    while (dataset.size() < size) {
-        // для начала немного апдейтнем лабиринт
-        MutationManager<21, 31> mm;
+// Размечает count различных случайных позиций одного лабиринта.
+// Перебор 512 вариантов для разных позиций независим, поэтому позиции делятся между потоками пула воркера,
+// у каждой подзадачи своя копия лабиринта. Без пула разметка идёт в вызывающем потоке.
+std::vector<std::pair<std::vector<float>, std::vector<float>>> get_samples(maze<21, 31> m, size_t count,
+                                                                           ThreadPool *pool = nullptr,
+                                                                           WorkerCounters *stats = nullptr) {
+    // все допустимые центры квадрата: x 2..18, y 2..28
+    std::vector<std::pair<int, int>> positions;
+    for (int x = 2; x <= 18; x++) {
+        for (int y = 2; y <= 28; y++) {
+            positions.push_back({x, y});
+        }
+    }
+    count = std::min(count, positions.size());
+    for (size_t i = 0; i < count; i++) {
+        std::swap(positions[i], positions[i + r() % (positions.size() - i)]);
+    }
+    positions.resize(count);
 
-        size_t score = pass_maze<21, 31>(m);
-        clean_maze<21, 31>(m);
-        for (int i = 0; i < num_updates; i++) {
-            // std::cout << "Iteration " << i << " with score " << score << std::endl;
-            mm.apply_random_mutation(m);
-            if (!is_solvable<21, 31>(m)) {
-                mm.deny_last_mutation(m);
-                i--;
-                continue;
-            }
-            size_t new_score = pass_maze<21, 31>(m);
-            clean_maze<21, 31>(m);
-            if (new_score > score * 0.99 - 10) {
-                score = new_score;
-                // system("cls");
-                // std::cout << "Score: " << score << std::endl;
-                // show_maze<21, 31>(m);
-            } else {
-                mm.deny_last_mutation(m);
-                i--;
-            }
+    std::vector<std::pair<std::vector<float>, std::vector<float>>> samples(count);
+    size_t sub_tasks = pool ? std::max<size_t>(1, std::min(pool->size(), count)) : 1;
+
+    if (sub_tasks == 1) {
+        for (size_t i = 0; i < count; i++) {
+            samples[i] = get_sample(m, positions[i].first, positions[i].second, stats);
         }
+        return samples;
+    }
 
-        // теперь выберем случайную точку в лабиринте
-        int x = (r() % (18 - 2 + 1)) + 2;
-        int y = (r() % (28 - 2 + 1)) + 2;
+    // у счётчиков воркера один писатель, поэтому подзадачи копят в свои, а время разметки меряем по стене
+    ScopedTimer timer(stats ? &stats->labelling_ns : nullptr);
+    std::vector<WorkerCounters> sub_stats(sub_tasks);
+    pool->run(sub_tasks, [&](size_t t) {
+        maze<21, 31> local;
+        std::copy(&m[0][0], &m[0][0] + 21 * 31, &local[0][0]);
+        for (size_t i = t; i < count; i += sub_tasks) {
+            samples[i] = get_sample(local, positions[i].first, positions[i].second, &sub_stats[t]);
+        }
+    });
+
+    if (stats) {
+        for (const auto &s : sub_stats) {
+            CountersSnapshot snapshot(s);
+            WorkerCounters::add(stats->samples, snapshot.samples);
+            WorkerCounters::add(stats->pass_maze_calls, snapshot.pass_maze_calls);
+            WorkerCounters::add(stats->unsolvable, snapshot.unsolvable);
+        }
+    }
 
-        auto [input, output] = get_sample(m, x, y);
+    return samples;
+}
 
-        dataset.add(std::make_pair(input, output));
+// evolver продолжает свой лабиринт между вызовами: перед первым сэмплом num_updates шагов разогрева,
+// перед каждым следующим - decorrelation_steps. С каждого лабиринта берётся samples_per_maze разных позиций.
+DS get_dataset_from_search(MazeEvolver<21, 31> &evolver, size_t size, int num_updates, int decorrelation_steps,
+                           size_t samples_per_maze = 1, ThreadPool *pool = nullptr, WorkerCounters *stats = nullptr) {
+    DS dataset;
+    while (dataset.size() < size) {
+        // для начала немного апдейтнем лабиринт
+        evolver.advance(num_updates, decorrelation_steps, stats);
+
+        // теперь выберем случайные точки в лабиринте
+        size_t count = std::min(samples_per_maze, size - dataset.size());
+        for (auto &sample : get_samples(evolver.m, count, pool, stats)) {
+            dataset.add(sample);
+        }
     }
 
     return dataset;
 }
 
+DS get_dataset_from_search(size_t size, int num_updates, WorkerCounters *stats = nullptr) {
+    MazeEvolver<21, 31> evolver;
+    return get_dataset_from_search(evolver, size, num_updates, num_updates, 1, nullptr, stats);
+}
+
 class Data_generator {
   public:
     enum Command { STOP, NONE };
 
-    int num_workers, sample_size, num_updates;
+    int num_workers, sample_size, num_updates, decorrelation_steps, samples_per_maze, sub_tasks;
     std::vector<std::optional<std::thread>> threads;
     std::vector<int> stats;
+    GeneratorStats counters;                   // обновляются воркерами без блокировок
+    std::unique_ptr<StatsDumper> stats_dumper; // периодическая запись counters в файл
     std::thread manager_thread;
     std::atomic_flag manager_command_done; // only checks in manager thread, set in main thread
     std::atomic_flag manager_in_progress;  // only checks in main thread, set in manager thread
     Command manager_command;
 
     std::vector<DS> datasets;
+    // упакованные файлы, подключённые пунктом 9: отображены в память и не разворачиваются, при сохранении
+    // их записи копируются в выходной файл
+    std::vector<DatasetView> packed_files;
+    ScoreCache score_cache;                    // оценки лабиринтов, общие для всех воркеров
+    std::vector<MazeEvolver<21, 31>> evolvers; // у каждого воркера свой лабиринт, живёт между батчами
+    // у каждого воркера свой постоянный пул на sub_tasks потоков для разметки: run() одного пула из разных
+    // воркеров шли бы по очереди, а потоки на каждый лабиринт дороже самой разметки небольшого числа позиций
+    std::vector<std::unique_ptr<ThreadPool>> pools;
     std::vector<std::atomic_flag> command_done;             // only checks in worker threads, set in manager thread
     std::vector<std::atomic_flag> computations_in_progress; // only checks in manager thread, set in worker threads
     Command command;
@@ -398,14 +279,21 @@ class Data_generator {
     std::mutex mtx;
     std::condition_variable cv;
 
-    Data_generator(int num_workers, int sample_size, int num_updates)
-        : num_workers(num_workers), sample_size(sample_size), num_updates(num_updates), threads(num_workers),
-          stats(num_workers), datasets(num_workers), command_done(num_workers), computations_in_progress(num_workers),
+    Data_generator(int num_workers, int sample_size, int num_updates, int decorrelation_steps, int samples_per_maze = 1,
+                   int sub_tasks = 1)
+        : num_workers(num_workers), sample_size(sample_size), num_updates(num_updates),
+          decorrelation_steps(decorrelation_steps), samples_per_maze(samples_per_maze), sub_tasks(sub_tasks),
+          threads(num_workers), stats(num_workers), counters(num_workers),
+          datasets(num_workers), evolvers(num_workers), command_done(num_workers), computations_in_progress(num_workers),
           command(NONE) {
         for (size_t i = 0; i < num_workers; i++) {
             command_done[i].test_and_set();
             computations_in_progress[i].clear();
             stats[i] = 0;
+            evolvers[i].set_score_cache(&score_cache);
+            if (sub_tasks > 1) {
+                pools.push_back(std::make_unique<ThreadPool>(sub_tasks));
+            }
         }
 
         manager_command_done.test_and_set();
@@ -480,7 +368,9 @@ class Data_generator {
     }
 
     void thread_worker(size_t index) {
-        this->datasets[index] = get_dataset_from_search(sample_size, num_updates);
+        this->datasets[index] = get_dataset_from_search(evolvers[index], sample_size, num_updates, decorrelation_steps,
+                                                        samples_per_maze, pools.empty() ? nullptr : pools[index].get(),
+                                                        &counters.worker(index));
         this->computations_in_progress[index].clear();
         cv.notify_one();
     }
@@ -501,7 +391,24 @@ class Data_generator {
 
         // std::cout << "Unique dataset size: " << dataset.size() << std::endl;
 
-        return dataset.write_to_file(filename);
+        // упакованный формат; текстовый остаётся запасным вариантом для сэмплов другой структуры
+        if (packed_files.empty()) {
+            return dataset.write_packed(filename) || dataset.write_to_file(filename);
+        }
+        // filename может быть подключён (autosave.bin после пункта 9): write_packed заменяет его через
+        // временный файл и подключает заново
+        return dataset.write_packed(filename, packed_files);
+    }
+
+    // Подключает упакованный файл без чтения сэмплов в память; false, если файл не упакованный
+    bool attach_packed_file(const std::string &filename) {
+        std::lock_guard<std::mutex> lock(mtx);
+        DatasetView view(filename);
+        if (!view.is_open()) {
+            return false;
+        }
+        packed_files.push_back(std::move(view));
+        return true;
     }
 
     bool read_dataset_from_file(const std::string &filename) {
@@ -524,9 +431,14 @@ class Data_generator {
         return true;
     }
 
+    // вместе с подключёнными упакованными файлами, повторы в них удаляются только при сохранении
     size_t get_dataset_size() {
         std::lock_guard<std::mutex> lock(mtx);
-        return dataset.size();
+        size_t size = dataset.size();
+        for (const auto &view : packed_files) {
+            size += view.size();
+        }
+        return size;
     }
 
     void notify() { cv.notify_all(); }
@@ -536,6 +448,18 @@ class Data_generator {
         for (size_t i = 0; i < num_workers; i++) {
             std::cout << "Worker " << i << " stats: " << stats[i] << std::endl;
         }
+        counters.print(std::cout);
+    }
+
+    // period_ms = 0 останавливает запись
+    bool dump_stats_to_file(const std::string &filename, bool json, size_t period_ms) {
+        stats_dumper.reset();
+        if (period_ms == 0) {
+            return true;
+        }
+        stats_dumper = std::make_unique<StatsDumper>(counters, filename, json ? StatsDumper::JSON : StatsDumper::CSV,
+                                                     std::chrono::milliseconds(period_ms));
+        return stats_dumper->is_open();
     }
 
     void write_to_file_as_csv(const std::string &filename) {
@@ -545,6 +469,7 @@ class Data_generator {
     }
 
     ~Data_generator() {
+        stats_dumper.reset();
         {
             std::lock_guard<std::mutex> lock(mtx);
             manager_command = STOP;
@@ -561,6 +486,9 @@ void data_generator_memu() {
     int num_workers = 20;
     int sample_size = 100;
     int num_updates = 10;
+    int decorrelation_steps = 10;
+    int samples_per_maze = 1;
+    int sub_tasks = 1;
 
     std::cout << "Enter number of workers: ";
     std::cin >> num_workers;
@@ -571,12 +499,22 @@ void data_generator_memu() {
     std::cout << "Enter number of updates: ";
     std::cin >> num_updates;
 
-    std::cout << "Starting data generator with " << num_workers << " workers, sample size " << sample_size << " and "
-              << num_updates << " updates" << std::endl;
+    std::cout << "Enter number of decorrelation steps between samples: ";
+    std::cin >> decorrelation_steps;
+
+    std::cout << "Enter number of samples per maze: ";
+    std::cin >> samples_per_maze;
+
+    std::cout << "Enter number of sub-tasks per worker: ";
+    std::cin >> sub_tasks;
+
+    std::cout << "Starting data generator with " << num_workers << " workers, sample size " << sample_size << ", "
+              << num_updates << " warm-up updates, " << decorrelation_steps << " decorrelation steps, "
+              << samples_per_maze << " samples per maze and " << sub_tasks << " sub-tasks" << std::endl;
 
     // std::cout << "Do not forget to manually notify to start computations" << std::endl;
 
-    Data_generator dg(num_workers, sample_size, num_updates);
+    Data_generator dg(num_workers, sample_size, num_updates, decorrelation_steps, samples_per_maze, sub_tasks);
     std::this_thread::sleep_for(std::chrono::milliseconds(1000));
     dg.notify(); // start computations
 
@@ -594,6 +532,9 @@ void data_generator_memu() {
         std::cout << "7 - write to csv" << std::endl;
         std::cout << "8 - show bin files" << std::endl;
         std::cout << "9 - read all bin files" << std::endl;
+        std::cout << "10 - dump stats to file periodically" << std::endl;
+        std::cout << "11 - train network on packed bin file" << std::endl;
+        std::cout << "12 - convert text network file to binary" << std::endl;
         std::cout << "Enter command: ";
         std::cin >> command;
 
@@ -642,7 +583,13 @@ void data_generator_memu() {
         case 8: {
             for (const auto &entry : std::filesystem::directory_iterator(".")) {
                 if (entry.path().extension() == ".bin") {
-                    Data_generator dd(1, 1000, 10);
+                    // для упакованных файлов размер есть в заголовке, читать сэмплы не нужно
+                    DatasetView view(entry.path().filename().string());
+                    if (view.is_open()) {
+                        std::cout << entry.path().filename() << " size: " << view.size() << std::endl;
+                        continue;
+                    }
+                    Data_generator dd(1, 1000, 10, 10);
                     dd.manager_command = Data_generator::STOP;
                     dd.read_dataset_from_file(entry.path().filename().string());
                     std::cout << entry.path().filename() << " size: " << dd.get_dataset_size() << std::endl;
@@ -654,12 +601,62 @@ void data_generator_memu() {
             std::cout << "Size before: " << dg.get_dataset_size() << std::endl;
             for (const auto &entry : std::filesystem::directory_iterator(".")) {
                 if (entry.path().extension() == ".bin") {
-                    dg.read_dataset_from_file(entry.path().filename().string());
+                    // упакованные файлы подключаются через DatasetView, текстовые читаются в память
+                    std::string filename = entry.path().filename().string();
+                    if (!dg.attach_packed_file(filename)) {
+                        dg.read_dataset_from_file(filename);
+                    }
                     std::cout << entry.path().filename() << " size after: " << dg.get_dataset_size() << std::endl;
                 }
             }
             break;
         }
+        case 10: {
+            std::cout << "Enter file name" << std::endl;
+            std::string filename;
+            std::cin >> filename;
+            std::cout << "Enter format (csv/json)" << std::endl;
+            std::string format;
+            std::cin >> format;
+            std::cout << "Enter period in ms (0 - stop)" << std::endl;
+            size_t period_ms;
+            std::cin >> period_ms;
+            if (dg.dump_stats_to_file(filename, format == "json", period_ms)) {
+                std::cout << (period_ms ? "Dumping stats to " + filename : "Stats dump stopped") << std::endl;
+            } else {
+                std::cout << "Error opening " << filename << std::endl;
+            }
+            break;
+        }
+        case 11: {
+            std::cout << "Enter file name" << std::endl;
+            std::string filename;
+            std::cin >> filename;
+            DatasetView view(filename);
+            if (!view.is_open()) {
+                std::cout << "Error: " << filename << " is not a packed dataset" << std::endl;
+                break;
+            }
+            std::cout << "Enter hidden layer size, epochs and learning rate" << std::endl;
+            size_t hidden, epochs;
+            double learning_rate;
+            std::cin >> hidden >> epochs >> learning_rate;
+            MLP mlp({view.input_size(), hidden, view.output_size()});
+            mlp.Train(view, learning_rate, epochs, 0, 0, ConsoleSink());
+            std::cout << "Score: " << mlp.Score(view) << std::endl;
+            break;
+        }
+        case 12: {
+            std::cout << "Enter text and binary file names" << std::endl;
+            std::string text_filename, binary_filename;
+            std::cin >> text_filename >> binary_filename;
+            if (nn_file::convert_text_model<double>(text_filename, binary_filename)) {
+                std::cout << "Converted to " << binary_filename << std::endl;
+            } else {
+                std::cout << "Error: could not convert " << text_filename << std::endl;
+            }
+            break;
+        }
         }
     }
 }
@@ -17,6 +17,7 @@
 #include <cassert>
 #include <maze_utils.hpp>
 #include <nn.hpp>
+#include <pbt.hpp>
 #include <researcher.hpp>
 
 using namespace utils;
@@ -522,69 +523,25 @@ class Trainer {
     }
 };
 
-class SelectiveTrainer {
-  public:
-    using NN = NeuralNetwork<72, 7, 81, 9, ActivationFunction::Sigmoid>;
-
-    Dataset dataset;
-    NN nn;
-
-    SelectiveTrainer(Dataset dataset) { this->dataset = dataset; }
-
-    void iteration(int num_workers, int num_iterations) {
-        // shuffle dataset
-        std::random_shuffle(dataset.begin(), dataset.end());
-
-        std::vector<NN> nns(num_workers);
-        for (auto &n : nns) {
-            n = nn;
-        }
-
-        std::vector<std::thread> threads;
-        std::vector<double> last_errors;
-        // D
-        for (size_t i = 0; i < num_workers; i++) {
-            last_errors.push_back(0);
-            threads.push_back(std::thread([this, i, num_iterations, &nns, &last_errors]() {
-                last_errors[i] = nns[i].Train(this->dataset, 0.000001 + i / 1000000., num_iterations, 3e-4, 0.0001);
-            }));
-        }
-        // D
-        for (auto &t : threads) {
-            t.join();
-        }
-        // D
-        double best_error = std::numeric_limits<double>::max();
-        size_t best_index = 0;
-
-        for (size_t i = 0; i < num_workers; i++) {
-            if (last_errors[i] < best_error) {
-                best_error = last_errors[i];
-                best_index = i;
-            }
-        }
-
-        nn = nns[best_index];
-
-        std::cout << "Best error: " << best_error << std::endl;
-        std::cout << "Best score: " << nn.Score(dataset) << std::endl;
-    }
-
-    NN get_nn() { return nn; }
-};
-
+// SelectiveTrainer заменён PopulationTrainer из pbt.hpp
 void selective_trainer() {
+    using NN = NeuralNetwork<72, 7, 81, 9, ActivationFunction::Sigmoid>;
     Dataset dataset = read_dataset_from_file("good_100k_2.bin");
-
-    SelectiveTrainer st(dataset);
-
+    std::random_shuffle(dataset.begin(), dataset.end());
+    Dataset validation(dataset.end() - dataset.size() / 10, dataset.end());
+    dataset.resize(dataset.size() - validation.size());
+
+    ThreadPool pool;
+    PopulationOptions options;
+    options.population = pool.size();
+    options.learning_rate_min = 1e-6;
+    options.learning_rate_max = 1e-5;
+    PopulationTrainer<NN> trainer(dataset, validation, options, pool);
     for (int i = 0; i < 100; i++) {
-        st.iteration(10, 10);
+        std::cout << "Best validation error: " << trainer.Round() << std::endl;
     }
 
-    auto nn = st.get_nn();
-
-    nn.save_to_file("good_nn_100k_2.nn");
+    trainer.best()->save_binary("good_nn_100k_2.nnb");
 }
 
 */
\ No newline at end of file
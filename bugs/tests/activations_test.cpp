@@ -0,0 +1,89 @@
+#include <bitset>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <activations.hpp>
+#include <nn.hpp>
+
+// Максимальная ошибка приближения на [-20, 20] относительно точной сигмоиды в double
+template <typename Policy, typename T>
+double max_error() {
+    double error = 0;
+    for (double x = -20; x <= 20; x += 1e-3) {
+        double exact = 1 / (1 + std::exp(-x));
+        error = std::max(error, std::abs(double(Policy::apply(T(x))) - exact));
+    }
+    return error;
+}
+
+// Время на одно вычисление по массиву входов, как в цикле активаций по строке слоя
+template <typename Policy, typename T>
+double ns_per_call(const std::vector<T> &inputs, std::vector<T> &outputs) {
+    const int repeats = 20;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++) {
+        for (size_t i = 0; i < inputs.size(); i++) {
+            outputs[i] = Policy::apply(inputs[i]);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return seconds * 1e9 / (double(repeats) * inputs.size());
+}
+
+template <typename Policy>
+bool check(const std::string &name, double tolerance, std::vector<float> &inputs, std::vector<float> &outputs) {
+    double error_float = max_error<Policy, float>(), error_double = max_error<Policy, double>();
+    std::cout << name << ": max error " << error_float << " (float), " << error_double << " (double), "
+              << ns_per_call<Policy>(inputs, outputs) << " ns/call (float)" << std::endl;
+    if (error_float > tolerance || error_double > tolerance) {
+        std::cout << "Error: " << name << " is less accurate than " << tolerance << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    std::mt19937 gen(5);
+    std::normal_distribution<float> dist(0, 4);
+    std::vector<float> inputs(1 << 16), outputs(1 << 16);
+    for (auto &x : inputs) {
+        x = dist(gen);
+    }
+
+    // вне [-8, 8] таблица насыщается, отсюда её ошибка sigmoid(-8)
+    if (!check<ExactSigmoid>("exact", 1e-6, inputs, outputs) || !check<TableSigmoid>("table", 4e-4, inputs, outputs) ||
+        !check<RationalSigmoid>("rational", 6e-5, inputs, outputs)) {
+        return 1;
+    }
+    if (std::abs(TableSigmoid::apply(1.f) - ExactSigmoid::apply(1.f)) > 1e-5) {
+        std::cout << "Error: table interpolation is inaccurate inside the range" << std::endl;
+        return 1;
+    }
+
+    // сеть с приближённой сигмоидой обучается так же
+    std::vector<std::pair<std::bitset<72>, std::bitset<9>>> dataset(256);
+    for (auto &[input, output] : dataset) {
+        for (size_t i = 0; i < 72; i++) {
+            input[i] = gen() % 2;
+        }
+        for (size_t i = 0; i < 9; i++) {
+            output[i] = input[i] | input[i + 9];
+        }
+    }
+    NeuralNetwork<72, 2, 24, 9, ActivationFunction::Sigmoid, float, RationalSigmoid> rational;
+    double first = rational.Train(dataset, 1.0, 1, 0, 0);
+    double last = rational.Train(dataset, 1.0, 30, 0, 0);
+    if (!(last < first * 0.5)) {
+        std::cout << "Error: network with rational sigmoid does not train: " << first << " -> " << last << std::endl;
+        return 1;
+    }
+
+    std::cout << "All activations test passed!" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <conv_net.hpp>
+#include <maze_features.hpp>
+
+#include "test_data.hpp"
+
+using test_data::rows, test_data::cols, test_data::cells;
+
+// Сэмплы той же структуры, что и у get_sample, по несколько позиций на лабиринт
+DS generate_dataset(size_t mazes, size_t per_maze, std::mt19937 &gen) {
+    DS ds;
+    for (size_t m = 0; m < mazes; m++) {
+        std::vector<float> planes = test_data::random_planes(gen);
+        for (size_t s = 0; s < per_maze; s++) {
+            ds.add(test_data::window_sample(planes, gen));
+        }
+    }
+    return ds;
+}
+
+int main() {
+    std::mt19937 gen(4);
+
+    // выход клетки зависит только от окна радиуса 1 + 2 вокруг неё и одинаков при сдвиге лабиринта
+    {
+        ConvNet net(rows, cols, {2, 4, 9}, {3, 5}, ActivationFunction::LeakyReLU, 1);
+        std::vector<float> planes = test_data::random_planes(gen);
+        const float *output = net.Forward(planes.data());
+        std::vector<float> before(output, output + cells * 9);
+
+        std::vector<float> changed(planes);
+        changed[10 * cols + 15] = 1 - changed[10 * cols + 15];
+        const float *after = net.Forward(changed.data());
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < cols; j++) {
+                bool near = std::abs(i - 10) <= 3 && std::abs(j - 15) <= 3;
+                for (int o = 0; o < 9; o++) {
+                    size_t k = (i * cols + j) * 9 + o;
+                    if (!near && after[k] != before[k]) {
+                        std::cout << "Error: cell (" << i << ", " << j << ") depends on a cell outside its window"
+                                  << std::endl;
+                        return 1;
+                    }
+                }
+            }
+        }
+
+        std::vector<float> shifted(cells * 2, 0.f);
+        for (int c = 0; c < 2; c++) {
+            for (int i = 0; i + 1 < rows; i++) {
+                for (int j = 0; j + 2 < cols; j++) {
+                    shifted[c * cells + (i + 1) * cols + j + 2] = planes[c * cells + i * cols + j];
+                }
+            }
+        }
+        const float *moved = net.Forward(shifted.data());
+        for (int i = 3; i + 4 < rows; i++) {
+            for (int j = 3; j + 5 < cols; j++) {
+                for (int o = 0; o < 9; o++) {
+                    if (std::abs(moved[((i + 1) * cols + j + 2) * 9 + o] - before[(i * cols + j) * 9 + o]) > 1e-5f) {
+                        std::cout << "Error: convolution is not translation invariant" << std::endl;
+                        return 1;
+                    }
+                }
+            }
+        }
+    }
+
+    // обучение по DS: квадрат стенок вокруг позиции выучивается одним слоем 3x3
+    {
+        DS train = generate_dataset(40, 8, gen);
+        DS test = generate_dataset(20, 8, gen);
+        ConvNet net(rows, cols, {2, 16, 9}, {3, 1}, ActivationFunction::LeakyReLU, 2);
+        double first = net.Train(train, 0.1, 1, 0, 0);
+        double last = net.Train(train, 0.1, 60, 0, 0);
+        double score = net.Score(test);
+        if (!(last < first * 0.1) || score < 0.9) {
+            std::cout << "Error: ConvNet does not learn local walls: " << first << " -> " << last << ", score "
+                      << score << std::endl;
+            return 1;
+        }
+    }
+
+    // плоскости лабиринта: стены по рамке, посещения нормированы на максимум
+    {
+        utils::maze<rows, cols> m;
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < cols; j++) {
+                m[i][j] = (i == 0 || j == 0 || i == rows - 1 || j == cols - 1) ? utils::MX : 0;
+            }
+        }
+        std::vector<float> planes(cells * 2);
+        utils::maze_planes<rows, cols>(m, planes.data());
+        float max_visits = *std::max_element(planes.begin() + cells, planes.end());
+        if (planes[0] != 1.f || planes[cols + 1] != 0.f || planes[cells] != 0.f || max_visits != 1.f ||
+            planes[cells + cols + 1] <= 0.f || m[1][1] != 0) {
+            std::cout << "Error: wrong maze planes" << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "All conv_net test passed!" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <dataset.hpp>
+
+#include "test_data.hpp"
+
+bool same_sample(const std::pair<std::vector<float>, std::vector<float>> &a,
+                 const std::pair<std::vector<float>, std::vector<float>> &b) {
+    if (a.first.size() != b.first.size() || a.second != b.second) {
+        return false;
+    }
+    for (size_t i = 0; i < a.first.size(); i++) {
+        if (std::abs(a.first[i] - b.first[i]) > 1e-4) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    std::mt19937 gen(42);
+    const std::string filename = (std::filesystem::temp_directory_path() / "dataset_test.bin").string();
+
+    DS ds;
+    for (int i = 0; i < 1000; i++) {
+        ds.add(test_data::random_sample(gen));
+    }
+
+    if (!ds.write_packed(filename)) {
+        std::cout << "Error writing packed dataset" << std::endl;
+        return 1;
+    }
+
+    DatasetView view(filename);
+    if (!view.is_open() || view.size() != ds.size() || view.input_size() != 1953 || view.output_size() != 9) {
+        std::cout << "Error opening packed dataset" << std::endl;
+        return 1;
+    }
+
+    for (size_t i : view.shuffled_indices()) {
+        if (!same_sample(view[i], ds[i])) {
+            std::cout << "Error in sample " << i << std::endl;
+            return 1;
+        }
+    }
+
+    DS loaded;
+    if (!loaded.read_from_file(filename) || loaded.size() != ds.size() || !same_sample(loaded[7], ds[7])) {
+        std::cout << "Error reading packed dataset through Dataset" << std::endl;
+        return 1;
+    }
+
+    // слияние с упакованным файлом без разворачивания: записи файла копируются, повторы входа отбрасываются
+    {
+        const auto merged_filename = (std::filesystem::temp_directory_path() / "dataset_test_merged.bin").string();
+        std::vector<DatasetView> views;
+        views.emplace_back(filename);
+        DS fresh;
+        fresh.add(ds[3]);
+        fresh.add(test_data::random_sample(gen));
+        bool ok = fresh.write_packed(merged_filename, views);
+        DatasetView merged(merged_filename);
+        if (!ok || !merged.is_open() || merged.size() != ds.size() + 1 || !same_sample(merged[0], ds[3]) ||
+            !same_sample(merged[1], fresh[1]) || !same_sample(merged[2], ds[0])) {
+            std::cout << "Error merging packed datasets" << std::endl;
+            return 1;
+        }
+        std::remove(merged_filename.c_str());
+
+        // сохранение в подключённый файл (autosave.bin после пункта 9 меню): файл заменяется объединением,
+        // а его представление открывается заново на новом содержимом
+        DS extra;
+        extra.add(test_data::random_sample(gen));
+        if (!extra.write_packed(filename, views) || !views[0].is_open() || views[0].size() != ds.size() + 1 ||
+            !same_sample(views[0][0], extra[0]) || !same_sample(views[0][1], ds[0]) ||
+            std::filesystem::exists(filename + ".tmp")) {
+            std::cout << "Error saving into an attached packed dataset" << std::endl;
+            return 1;
+        }
+        views.clear();
+        if (!ds.write_packed(filename)) {
+            std::cout << "Error rewriting packed dataset" << std::endl;
+            return 1;
+        }
+    }
+
+    // испорченный заголовок не открывается, испорченный квадрат в записи не пишет за пределы сэмпла
+    {
+        auto corrupt = [&](size_t offset, const unsigned char *bytes, size_t size) {
+            std::fstream file(filename, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(offset);
+            file.write(reinterpret_cast<const char *>(bytes), size);
+        };
+        packed::Layout layout;
+        unsigned char bytes[8];
+        packed::put_u64(bytes, uint64_t(1) << 62);
+        corrupt(32, bytes, 8);
+        if (DatasetView(filename).is_open()) {
+            std::cout << "Error: packed dataset with an oversized count was opened" << std::endl;
+            return 1;
+        }
+        packed::put_u64(bytes, ds.size());
+        corrupt(32, bytes, 8);
+        packed::put_u32(bytes, 1000);
+        corrupt(12, bytes, 4);
+        if (DatasetView(filename).is_open()) {
+            std::cout << "Error: packed dataset of another shape was opened" << std::endl;
+            return 1;
+        }
+        packed::put_u32(bytes, layout.rows);
+        corrupt(12, bytes, 4);
+        bytes[0] = 0;
+        corrupt(packed::header_size + layout.window_offset(), bytes, 1);
+        DatasetView broken(filename);
+        auto sample = broken.is_open() ? broken[0] : decltype(broken[0]){};
+        if (sample.first.size() != layout.input_size() ||
+            std::count(sample.first.begin() + 2 * layout.cells(), sample.first.end(), 1.f) != 0) {
+            std::cout << "Error: corrupted window of a packed record was expanded" << std::endl;
+            return 1;
+        }
+    }
+
+    // сэмпл без квадрата 3x3 упаковать нельзя
+    DS bad;
+    bad.add(std::vector<float>(1953, 0.f), std::vector<float>(9, 0.f));
+    if (bad.write_packed(filename)) {
+        std::cout << "Error: sample without window was packed" << std::endl;
+        return 1;
+    }
+
+    // текстовый формат по-прежнему читается
+    if (!ds.write_to_file(filename) || !loaded.read_from_file(filename) || loaded.size() != 2 * ds.size() ||
+        !same_sample(loaded[ds.size() + 3], ds[3])) {
+        std::cout << "Error in text dataset round trip" << std::endl;
+        return 1;
+    }
+
+    // повторы находятся и среди копий, прошедших через текстовый и упакованный файлы, хотя шаги в них
+    // округлены по-разному
+    {
+        DS text, packed_copy;
+        if (!ds.write_to_file(filename) || !text.read_from_file(filename) || !ds.write_packed(filename) ||
+            !packed_copy.read_from_file(filename)) {
+            std::cout << "Error writing dataset copies" << std::endl;
+            return 1;
+        }
+        DS copies = ds;
+        copies.insert(text);
+        copies.insert(packed_copy);
+        copies.unique();
+        if (copies.size() != ds.size()) {
+            std::cout << "Error: unique keeps " << copies.size() << " of " << ds.size() << " samples and their copies"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    std::remove(filename.c_str());
+
+    // unique() учитывает только вход и при повторном вызове проверяет только добавленные сэмплы
+    DS merged = ds;
+    merged.unique();
+    auto dup = ds[5];
+    dup.second[0] = 1 - dup.second[0];
+    DS newcomers;
+    newcomers.add(dup);
+    newcomers.add(test_data::random_sample(gen));
+    merged.insert(newcomers);
+    merged.insert(newcomers);
+    merged.unique();
+    if (merged.size() != ds.size() + 1) {
+        std::cout << "Error in unique: expected " << ds.size() + 1 << ", got " << merged.size() << std::endl;
+        return 1;
+    }
+    // сэмпл, изменённый через operator[], проверяется заново
+    merged[0].first = merged[1].first;
+    merged.unique();
+    if (merged.size() != ds.size()) {
+        std::cout << "Error: unique misses a sample changed through operator[]" << std::endl;
+        return 1;
+    }
+
+    std::cout << "All dataset test passed!" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <bitset>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ensemble.hpp>
+
+#include "test_data.hpp"
+
+using NN = NeuralNetwork<72, 3, 24, 9, ActivationFunction::Sigmoid>;
+
+int main() {
+    std::mt19937 gen(11);
+    auto dataset = test_data::bit_dataset<NN>(300, gen);
+    std::vector<std::bitset<72>> inputs;
+    for (const auto &sample : dataset) {
+        inputs.push_back(sample.first);
+    }
+
+    std::vector<NN> models;
+    for (unsigned seed = 1; seed <= 3; seed++) {
+        models.emplace_back(seed);
+        models.back().Train(dataset, 1.0, 20, 0, 0, 16);
+    }
+    Ensemble<NN> ensemble(models);
+
+    // среднее и голосование совпадают с поштучным выводом каждой модели
+    {
+        Ensemble<NN>::Workspace ws;
+        NN::BatchWorkspace nn_ws;
+        std::vector<double> average(inputs.size() * 9), votes(inputs.size() * 9);
+        ensemble.ApplyBatch(inputs.data(), inputs.size(), average.data(), ws);
+        ensemble.ApplyBatch(inputs.data(), inputs.size(), votes.data(), ws, EnsembleCombine::Vote);
+
+        std::vector<double> expected_average(inputs.size() * 9), expected_votes(inputs.size() * 9);
+        std::vector<double> probabilities(inputs.size() * 9);
+        for (const auto &model : models) {
+            model.ApplyBatch(inputs.data(), inputs.size(), probabilities.data(), nn_ws);
+            for (size_t k = 0; k < probabilities.size(); k++) {
+                expected_average[k] += probabilities[k] / models.size();
+                expected_votes[k] += (probabilities[k] > 0.5) / double(models.size());
+            }
+        }
+        for (size_t k = 0; k < average.size(); k++) {
+            if (std::abs(average[k] - expected_average[k]) > 1e-9 || std::abs(votes[k] - expected_votes[k]) > 1e-9) {
+                std::cout << "Error: ensemble output " << k << " differs from its models" << std::endl;
+                return 1;
+            }
+        }
+        std::bitset<9> single = ensemble.Apply(inputs[5], EnsembleCombine::Vote);
+        for (size_t o = 0; o < 9; o++) {
+            if (single[o] != (votes[5 * 9 + o] > 0.5)) {
+                std::cout << "Error: single-sample Apply differs" << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    // загрузка из файлов
+    {
+        std::vector<std::string> filenames;
+        for (size_t m = 0; m < models.size(); m++) {
+            auto path = std::filesystem::temp_directory_path() / ("ensemble_test_" + std::to_string(m) + ".bin");
+            filenames.push_back(path.string());
+            models[m].save_binary(filenames.back());
+        }
+        auto loaded = Ensemble<NN>::Load(filenames);
+        for (const auto &filename : filenames) {
+            std::remove(filename.c_str());
+        }
+        if (!loaded || loaded->size() != 3 || loaded->Score(dataset) != ensemble.Score(dataset)) {
+            std::cout << "Error: ensemble loaded from files differs" << std::endl;
+            return 1;
+        }
+        if (Ensemble<NN>::Load({"missing_model.bin"})) {
+            std::cout << "Error: missing model file loaded" << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "All ensemble test passed!" << std::endl;
+
+    return 0;
+}
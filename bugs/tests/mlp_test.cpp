@@ -0,0 +1,53 @@
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <mlp.hpp>
+
+#include "test_data.hpp"
+
+int main() {
+    std::mt19937 gen(3);
+    DS ds;
+    for (int i = 0; i < 200; i++) {
+        ds.add(test_data::random_sample(gen));
+    }
+
+    // обучение прямо по DS
+    {
+        MLP mlp({21 * 31 * 3, 32, 9}, ActivationFunction::Sigmoid, 1);
+        double first = mlp.Train(ds, 0.1, 1, 0, 0);
+        double last = mlp.Train(ds, 0.1, 10, 0, 0);
+        if (!(last < first * 0.8)) {
+            std::cout << "Error: MLP training does not reduce error: " << first << " -> " << last << std::endl;
+            return 1;
+        }
+    }
+
+    // обучение по упакованному файлу даёт то же, что и по DS
+    {
+        const std::string filename = (std::filesystem::temp_directory_path() / "mlp_test.bin").string();
+        if (!ds.write_packed(filename)) {
+            std::cout << "Error writing packed dataset" << std::endl;
+            return 1;
+        }
+        DatasetView view(filename);
+        MLP a({21 * 31 * 3, 16, 16, 9}, ActivationFunction::LeakyReLU, 2);
+        MLP b({21 * 31 * 3, 16, 16, 9}, ActivationFunction::LeakyReLU, 2);
+        double ea = a.Train(ds, 0.05, 3, 0, 1e-5);
+        double eb = b.Train(view, 0.05, 3, 0, 1e-5);
+        std::remove(filename.c_str());
+        // шаги в файле квантованы, поэтому совпадение приближённое
+        if (std::abs(ea - eb) > 1e-2 * ea || std::abs(a.Score(ds) - b.Score(view)) > 0.05) {
+            std::cout << "Error: training from DatasetView differs from DS: " << ea << " vs " << eb << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "All mlp test passed!" << std::endl;
+
+    return 0;
+}
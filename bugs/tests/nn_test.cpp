@@ -0,0 +1,455 @@
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <maze_features.hpp>
+#include <nn.hpp>
+
+#include "test_data.hpp"
+
+using NN = NeuralNetwork<72, 3, 24, 9, ActivationFunction::Sigmoid>;
+using NNf = NeuralNetwork<72, 3, 24, 9, ActivationFunction::Sigmoid, float>;
+using Sample = std::pair<std::bitset<72>, std::bitset<9>>;
+
+template <typename Net>
+double max_weight_diff(const Net &a, const Net &b) {
+    double diff = 0;
+    for (size_t i = 0; i < a.weights_input_hidden_.size(); i++) {
+        for (size_t j = 0; j < a.weights_input_hidden_[i].size(); j++) {
+            diff = std::max(diff, std::abs(a.weights_input_hidden_[i][j] - b.weights_input_hidden_[i][j]));
+        }
+    }
+    for (size_t h = 0; h < a.weights_hidden_hidden_.size(); h++) {
+        for (size_t i = 0; i < a.weights_hidden_hidden_[h].size(); i++) {
+            for (size_t j = 0; j < a.weights_hidden_hidden_[h][i].size(); j++) {
+                diff = std::max(diff,
+                                std::abs(a.weights_hidden_hidden_[h][i][j] - b.weights_hidden_hidden_[h][i][j]));
+            }
+        }
+    }
+    for (size_t i = 0; i < a.weights_hidden_output_.size(); i++) {
+        for (size_t j = 0; j < a.weights_hidden_output_[i].size(); j++) {
+            diff = std::max(diff, std::abs(a.weights_hidden_output_[i][j] - b.weights_hidden_output_[i][j]));
+        }
+    }
+    for (size_t i = 0; i < a.bias_hidden_.size(); i++) {
+        diff = std::max(diff, std::abs(a.bias_hidden_[i] - b.bias_hidden_[i]));
+    }
+    for (size_t i = 0; i < a.bias_output_.size(); i++) {
+        diff = std::max(diff, std::abs(a.bias_output_[i] - b.bias_output_[i]));
+    }
+    return diff;
+}
+
+int main() {
+    std::mt19937 gen(7);
+    auto dataset = test_data::bit_dataset<NN>(256, gen);
+
+    // мини-батч из одного сэмпла - тот же SGD
+    {
+        NN sgd;
+        NN batch(sgd);
+        for (const auto &sample : dataset) {
+            double e1 = sgd.TrainIteration(sample.first, sample.second, 0.3, 1e-4);
+            double e2 = batch.TrainBatch(&sample, 1, 0.3, 1e-4);
+            if (std::abs(e1 - e2) > 1e-9) {
+                std::cout << "Error: batch of 1 error " << e2 << " differs from SGD error " << e1 << std::endl;
+                return 1;
+            }
+        }
+        double diff = max_weight_diff(sgd, batch);
+        if (diff > 1e-9) {
+            std::cout << "Error: batch of 1 weights differ from SGD by " << diff << std::endl;
+            return 1;
+        }
+    }
+
+    // градиент батча - сумма градиентов его сэмплов
+    {
+        NN nn;
+        NN::Gradients whole, parts;
+        NN::BatchWorkspace ws;
+        whole.clear();
+        parts.clear();
+        nn.ComputeBatchGradients(dataset.data(), 16, whole, ws);
+        for (size_t i = 0; i < 16; i++) {
+            nn.ComputeBatchGradients(dataset.data() + i, 1, parts, ws);
+        }
+        for (size_t k = 0; k < whole.values.size(); k++) {
+            if (std::abs(whole.values[k] - parts.values[k]) > 1e-9) {
+                std::cout << "Error: batch gradient is not a sum of sample gradients" << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    // мини-батчи обучаются
+    {
+        NN nn;
+        double first = nn.Train(dataset, 2.0, 1, 0, 0, 16);
+        double last = nn.Train(dataset, 2.0, 300, 0, 0, 16);
+        if (!(last < first)) {
+            std::cout << "Error: mini-batch training does not reduce error: " << first << " -> " << last << std::endl;
+            return 1;
+        }
+    }
+
+    // data-parallel батч совпадает с последовательным
+    {
+        ThreadPool pool(4);
+        NN serial;
+        NN parallel(serial);
+        for (size_t begin = 0; begin < dataset.size(); begin += 32) {
+            double e1 = serial.TrainBatch(dataset.data() + begin, 32, 0.5, 1e-4);
+            double e2 = parallel.TrainBatchParallel(dataset.data() + begin, 32, 0.5, 1e-4, pool);
+            if (std::abs(e1 - e2) > 1e-9) {
+                std::cout << "Error: parallel batch error " << e2 << " differs from serial " << e1 << std::endl;
+                return 1;
+            }
+        }
+        double diff = max_weight_diff(serial, parallel);
+        if (diff > 1e-9) {
+            std::cout << "Error: parallel batch weights differ from serial by " << diff << std::endl;
+            return 1;
+        }
+
+        NN hogwild;
+        double first = hogwild.Train(dataset, 2.0, 1, 0, 0, 8, &pool, true);
+        double last = hogwild.Train(dataset, 2.0, 100, 0, 0, 8, &pool, true);
+        if (!(last < first)) {
+            std::cout << "Error: hogwild training does not reduce error: " << first << " -> " << last << std::endl;
+            return 1;
+        }
+
+        // Adam в hogwild: у каждого потока свои моменты, обучение сходится так же
+        NN hogwild_adam;
+        TrainOptions options;
+        options.batch_size = 8;
+        options.pool = &pool;
+        options.hogwild = true;
+        options.optimizer = Optimizer::Adam;
+        first = hogwild_adam.Train(dataset, 0.01, 1, 0, 0, options).train_error;
+        last = hogwild_adam.Train(dataset, 0.01, 50, 0, 0, options).train_error;
+        if (!(last < first)) {
+            std::cout << "Error: hogwild Adam does not reduce error: " << first << " -> " << last << std::endl;
+            return 1;
+        }
+    }
+
+    // векторные ядра совпадают с наивными циклами, в том числе на хвостах
+    {
+        std::uniform_real_distribution<float> dist(-1, 1);
+        for (size_t n = 0; n < 70; n++) {
+            std::vector<float> x(n), y(n), z(n);
+            for (size_t i = 0; i < n; i++) {
+                x[i] = dist(gen);
+                y[i] = dist(gen);
+                z[i] = y[i];
+            }
+            double expected = 0;
+            for (size_t i = 0; i < n; i++) {
+                expected += double(x[i]) * y[i];
+            }
+            if (std::abs(nn_kernels::dot(x.data(), y.data(), n) - expected) > 1e-4) {
+                std::cout << "Error: dot of length " << n << " is wrong" << std::endl;
+                return 1;
+            }
+            nn_kernels::axpby(n, 0.5f, x.data(), 2.0f, z.data());
+            nn_kernels::axpy(n, -0.5f, x.data(), z.data());
+            for (size_t i = 0; i < n; i++) {
+                if (std::abs(z[i] - 2 * y[i]) > 1e-5) {
+                    std::cout << "Error: axpy/axpby of length " << n << " is wrong" << std::endl;
+                    return 1;
+                }
+            }
+        }
+    }
+
+    // float сеть с теми же весами считает так же, как double, с точностью float
+    {
+        NN nn;
+        NNf nnf;
+        const std::string filename = (std::filesystem::temp_directory_path() / "nn_test_weights.txt").string();
+        nn.save_to_file(filename);
+        nnf.load_from_file(filename);
+        std::remove(filename.c_str());
+
+        size_t same = 0;
+        for (const auto &[input, target] : dataset) {
+            same += nn.Apply(input) == nnf.Apply(input);
+        }
+        if (same < dataset.size() * 95 / 100) {
+            std::cout << "Error: float network agrees with double only on " << same << " samples" << std::endl;
+            return 1;
+        }
+
+        NNf batch(nnf);
+        for (size_t k = 0; k < 32; k++) {
+            double e = nn.TrainIteration(dataset[k].first, dataset[k].second, 0.3, 1e-4);
+            double ef = nnf.TrainIteration(dataset[k].first, dataset[k].second, 0.3, 1e-4);
+            double eb = batch.TrainBatch(&dataset[k], 1, 0.3, 1e-4);
+            if (std::abs(e - ef) > 1e-3 || std::abs(ef - eb) > 1e-4) {
+                std::cout << "Error: float training error " << ef << " / " << eb << " differs from double " << e
+                          << std::endl;
+                return 1;
+            }
+        }
+
+        NNf trained;
+        double first = trained.Train(dataset, 2.0, 1, 0, 0, 16);
+        double last = trained.Train(dataset, 2.0, 300, 0, 0, 16);
+        if (!(last < first)) {
+            std::cout << "Error: float training does not reduce error: " << first << " -> " << last << std::endl;
+            return 1;
+        }
+    }
+
+    // копия не делит буфер с оригиналом, перемещение сохраняет веса, сеть с тем же зерном та же
+    {
+        NN nn(42);
+        NN copy(nn);
+        if (max_weight_diff(nn, NN(42)) != 0 || max_weight_diff(nn, copy) != 0) {
+            std::cout << "Error: seeded network or copy differs" << std::endl;
+            return 1;
+        }
+        copy.TrainIteration(dataset[0].first, dataset[0].second, 0.5, 0);
+        if (max_weight_diff(nn, copy) == 0) {
+            std::cout << "Error: copy shares parameters with the original" << std::endl;
+            return 1;
+        }
+        NN moved(std::move(copy));
+        NN assigned;
+        assigned = moved;
+        if (max_weight_diff(moved, assigned) != 0 || moved.weights_input_hidden_.data() != moved.parameters()) {
+            std::cout << "Error: moved or assigned network differs" << std::endl;
+            return 1;
+        }
+        // присваивание в сеть, из которой переместили, снова даёт ей собственный буфер
+        copy = nn;
+        if (max_weight_diff(nn, copy) != 0 || copy.weights_input_hidden_.data() != copy.parameters() ||
+            copy.parameters() == nn.parameters()) {
+            std::cout << "Error: copy assignment into a moved-from network failed" << std::endl;
+            return 1;
+        }
+        // перемещённая сеть не делит память с исходной: её представления обнулены, а обученная заново
+        // исходная сеть не меняет веса перемещённой
+        NN before(moved);
+        NN target(std::move(moved));
+        NN assigned_target;
+        assigned_target = std::move(copy);
+        NN assigned_before(assigned_target);
+        if (moved.parameters() || moved.weights_input_hidden_.data() || copy.parameters() ||
+            copy.bias_output_.data()) {
+            std::cout << "Error: moved-from network keeps views into the moved buffer" << std::endl;
+            return 1;
+        }
+        moved = nn;
+        copy = nn;
+        moved.TrainIteration(dataset[1].first, dataset[1].second, 0.5, 0);
+        copy.TrainIteration(dataset[1].first, dataset[1].second, 0.5, 0);
+        if (max_weight_diff(target, before) != 0 || max_weight_diff(assigned_target, assigned_before) != 0 ||
+            target.weights_input_hidden_.data() != target.parameters()) {
+            std::cout << "Error: training the moved-from network changed the moved one" << std::endl;
+            return 1;
+        }
+    }
+
+    // бинарный файл: веса восстанавливаются точно, конвертированный текст даёт те же веса, порча и чужая форма
+    // отвергаются
+    {
+        NN nn;
+        NN loaded, converted;
+        const auto dir = std::filesystem::temp_directory_path();
+        const std::string text = (dir / "nn_test_weights.txt").string();
+        const std::string binary = (dir / "nn_test_weights.bin").string();
+        const std::string from_text = (dir / "nn_test_text.bin").string();
+        nn.save_to_file(text);
+        bool ok = nn.save_binary(binary) && loaded.load_binary(binary) &&
+                  nn_file::convert_text_model<double>(text, from_text) && converted.load_binary(from_text);
+        if (!ok || max_weight_diff(nn, loaded) != 0 || max_weight_diff(nn, converted) != 0) {
+            std::cout << "Error: binary model round trip failed" << std::endl;
+            return 1;
+        }
+
+        // веса из отображения файла без копирования; дообучение не трогает файл, копия получает свой буфер
+        NN mapped;
+        if (!mapped.map_binary(binary) || !mapped.is_mapped() || max_weight_diff(nn, mapped) != 0) {
+            std::cout << "Error: mapped binary model differs" << std::endl;
+            return 1;
+        }
+        NN mapped_copy(mapped);
+        mapped.TrainIteration(dataset[0].first, dataset[0].second, 0.5, 0);
+        if (mapped_copy.is_mapped() || max_weight_diff(nn, mapped_copy) != 0 || max_weight_diff(nn, mapped) == 0 ||
+            !loaded.load_binary(binary) || max_weight_diff(nn, loaded) != 0) {
+            std::cout << "Error: training a mapped model changed its file or its copy" << std::endl;
+            return 1;
+        }
+
+        NNf wrong_scalar;
+        NeuralNetwork<72, 2, 24, 9, ActivationFunction::Sigmoid> wrong_shape;
+        NeuralNetwork<72, 3, 24, 9, ActivationFunction::LeakyReLU> wrong_activation;
+        if (wrong_scalar.load_binary(binary) || wrong_shape.load_binary(binary) ||
+            wrong_activation.load_binary(binary) || wrong_scalar.map_binary(binary)) {
+            std::cout << "Error: binary model loaded into a different network" << std::endl;
+            return 1;
+        }
+
+        std::fstream file(binary, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(nn_file::header_size + 100);
+        file.put(0x55);
+        file.close();
+        if (loaded.load_binary(binary)) {
+            std::cout << "Error: corrupted binary model was loaded" << std::endl;
+            return 1;
+        }
+        // map_binary без verify не читает веса целиком и порчу не замечает, с verify - отказывает
+        NN lazy;
+        if (!lazy.map_binary(binary) || lazy.map_binary(binary, true)) {
+            std::cout << "Error: map_binary checks the checksum unless asked to" << std::endl;
+            return 1;
+        }
+        std::remove(text.c_str());
+        std::remove(binary.c_str());
+        std::remove(from_text.c_str());
+    }
+
+    // батчевый вывод совпадает с поштучным, оценка всех позиций лабиринта - с батчем по local_pattern
+    {
+        NN nn;
+        NN::BatchWorkspace ws;
+        std::vector<std::bitset<72>> inputs;
+        for (const auto &sample : dataset) {
+            inputs.push_back(sample.first);
+        }
+        std::vector<double> probabilities(inputs.size() * 9);
+        nn.ApplyBatch(inputs.data(), inputs.size(), probabilities.data(), ws);
+        for (size_t b = 0; b < inputs.size(); b++) {
+            std::bitset<9> output = nn.Apply(inputs[b]);
+            for (size_t i = 0; i < 9; i++) {
+                if (output[i] != (probabilities[b * 9 + i] > 0.5)) {
+                    std::cout << "Error: ApplyBatch differs from Apply for sample " << b << std::endl;
+                    return 1;
+                }
+            }
+        }
+
+        utils::maze<21, 31> m;
+        for (int i = 0; i < 21; i++) {
+            for (int j = 0; j < 31; j++) {
+                m[i][j] = (i == 0 || j == 0 || i == 20 || j == 30 || gen() % 3 == 0) ? utils::MX : 0;
+            }
+        }
+        utils::MazeScorer<NN, 21, 31> scorer;
+        scorer.apply(nn, m);
+        double single[9];
+        for (int i = 2; i <= 18; i++) {
+            for (int j = 2; j <= 28; j++) {
+                std::bitset<72> input = utils::local_pattern<21, 31>(m, i, j);
+                nn.ApplyBatch(&input, 1, single, ws);
+                for (size_t k = 0; k < 9; k++) {
+                    if (std::abs(single[k] - scorer.probability(i, j, k)) > 1e-12) {
+                        std::cout << "Error: MazeScorer differs at " << i << " " << j << std::endl;
+                        return 1;
+                    }
+                }
+            }
+        }
+    }
+
+    // Momentum и Adam из тех же весов за то же число эпох уходят ниже SGD
+    {
+        NN sgd(1);
+        NN momentum(sgd);
+        NN adam(sgd);
+        TrainOptions options;
+        options.batch_size = 16;
+        double sgd_error = sgd.Train(dataset, 0.5, 50, 0, 0, options).train_error;
+        options.optimizer = Optimizer::Momentum;
+        double momentum_error = momentum.Train(dataset, 0.5, 50, 0, 0, options).train_error;
+        options.optimizer = Optimizer::Adam;
+        double adam_error = adam.Train(dataset, 0.01, 50, 0, 0, options).train_error;
+        if (!(momentum_error < sgd_error) || !(adam_error < sgd_error)) {
+            std::cout << "Error: optimizers do not beat SGD: sgd " << sgd_error << ", momentum " << momentum_error
+                      << ", adam " << adam_error << std::endl;
+            return 1;
+        }
+    }
+
+    // ранняя остановка: мало данных, сеть переобучается, в конце восстанавливается лучшая эпоха
+    {
+        std::mt19937 noise(3);
+        auto small = test_data::bit_dataset<NN>(64, noise);
+        for (auto &sample : small) {
+            sample.second[noise() % 9].flip();
+        }
+        NN nn(2);
+        TrainOptions options;
+        options.batch_size = 8;
+        options.optimizer = Optimizer::Adam;
+        options.validation_fraction = 0.25;
+        options.patience = 5;
+        TrainResult result = nn.Train(small, 0.05, 2000, 0, 0, options);
+        if (result.epochs >= 2000 || result.epochs != result.best_epoch + options.patience + 1) {
+            std::cout << "Error: early stopping did not stop after patience: " << result.epochs << " epochs, best "
+                      << result.best_epoch << std::endl;
+            return 1;
+        }
+
+        std::vector<size_t> order(small.size());
+        for (size_t k = 0; k < order.size(); k++) {
+            order[k] = k;
+        }
+        std::shuffle(order.begin(), order.end(), std::mt19937(options.split_seed));
+        std::vector<Sample> validation;
+        for (size_t k = 0; k < 16; k++) {
+            validation.push_back(small[order[k]]);
+        }
+        if (std::abs(nn.Error(validation) - result.validation_error) > 1e-9) {
+            std::cout << "Error: restored weights give validation error " << nn.Error(validation) << " instead of "
+                      << result.validation_error << std::endl;
+            return 1;
+        }
+    }
+
+    // метрики эпох: по вызову на эпоху в порядке эпох, CSV - заголовок и строка на эпоху
+    {
+        std::mt19937 data(4);
+        auto dataset = test_data::bit_dataset<NN>(128, data);
+        NN nn(3);
+        std::vector<EpochMetrics> epochs;
+        std::ostringstream csv;
+        CsvSink sink(csv);
+        TrainOptions options;
+        options.batch_size = 4;
+        options.on_epoch = [&](const EpochMetrics &m) {
+            epochs.push_back(m);
+            sink(m);
+        };
+        TrainResult result = nn.Train(dataset, 0.5, 5, 0, 0, options);
+        bool ordered = epochs.size() == 5;
+        for (size_t e = 0; ordered && e < epochs.size(); e++) {
+            ordered = epochs[e].epoch == e && epochs[e].samples_per_second > 0 && epochs[e].learning_rate == 0.5 &&
+                      (e == 0 || epochs[e].elapsed_seconds >= epochs[e - 1].elapsed_seconds);
+        }
+        std::string text = csv.str();
+        size_t lines = std::count(text.begin(), text.end(), '\n');
+        if (!ordered || epochs.back().train_error != result.train_error || lines != 6) {
+            std::cout << "Error: wrong epoch metrics, " << epochs.size() << " callbacks, " << lines << " CSV lines"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "All nn test passed!" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <bitset>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <pattern_dataset.hpp>
+
+using Sample = PatternDataset::Sample;
+
+// Маленький набор входов, чтобы были повторы и конфликты выходов
+std::vector<Sample> generate_samples(size_t size, std::mt19937 &gen) {
+    std::vector<std::bitset<72>> inputs(size / 4);
+    for (auto &input : inputs) {
+        for (size_t i = 0; i < 72; i++) {
+            input[i] = gen() % 2;
+        }
+    }
+    std::vector<Sample> samples(size);
+    for (auto &[input, output] : samples) {
+        input = inputs[gen() % inputs.size()];
+        output = std::bitset<9>(gen() % 3 ? input.count() % 7 : gen() % 512);
+    }
+    return samples;
+}
+
+bool less(const Sample &a, const Sample &b) {
+    std::string ka = a.first.to_string(), kb = b.first.to_string();
+    return ka != kb ? ka < kb : a.second.to_ulong() < b.second.to_ulong();
+}
+
+int main() {
+    std::mt19937 gen(6);
+    auto samples = generate_samples(4000, gen);
+
+    // сортировка и повторы совпадают с сортировкой по строкам
+    {
+        PatternDataset ds(samples);
+        if (ds.size() != samples.size() || ds[17] != samples[17]) {
+            std::cout << "Error: samples are not stored as added" << std::endl;
+            return 1;
+        }
+        ds.dedup();
+        std::vector<Sample> expected(samples);
+        std::sort(expected.begin(), expected.end(), less);
+        expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+        if (ds.samples() != expected) {
+            std::cout << "Error: dedup differs from sorting by strings: " << ds.size() << " vs " << expected.size()
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    // статистика конфликтов и разрешение большинством
+    {
+        std::map<std::string, std::map<unsigned long, size_t>> votes;
+        for (const auto &[input, output] : samples) {
+            votes[input.to_string()][output.to_ulong()]++;
+        }
+        size_t conflicting = 0, conflicting_samples = 0, max_labels = 0;
+        std::vector<Sample> majority;
+        for (const auto &[key, labels] : votes) {
+            size_t count = 0, best = 0, best_count = 0;
+            for (const auto &[label, n] : labels) {
+                count += n;
+                if (n > best_count) {
+                    best = label;
+                    best_count = n;
+                }
+            }
+            if (labels.size() > 1) {
+                conflicting++;
+                conflicting_samples += count;
+            }
+            max_labels = std::max(max_labels, labels.size());
+            majority.push_back({std::bitset<72>(key), std::bitset<9>(best)});
+        }
+
+        PatternDataset ds(samples);
+        auto stats = ds.conflicts();
+        if (stats.samples != samples.size() || stats.unique_inputs != votes.size() ||
+            stats.conflicting_inputs != conflicting || stats.conflicting_samples != conflicting_samples ||
+            stats.max_labels != max_labels || conflicting == 0) {
+            std::cout << "Error: wrong conflict statistics" << std::endl;
+            return 1;
+        }
+        ds.dedup_inputs();
+        if (ds.samples() != majority) {
+            std::cout << "Error: dedup_inputs does not keep the majority output" << std::endl;
+            return 1;
+        }
+    }
+
+    // файл: фиксированная раскладка, чтение обратно, обрезанный файл отвергается
+    {
+        const std::string filename = (std::filesystem::temp_directory_path() / "pattern_dataset_test.bin").string();
+        PatternDataset ds(samples);
+        if (!ds.save(filename)) {
+            std::cout << "Error writing pattern dataset" << std::endl;
+            return 1;
+        }
+        std::ifstream file(filename, std::ios::binary);
+        std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        const unsigned char *record = bytes.data() + PatternDataset::header_size;
+        bool layout = bytes.size() == PatternDataset::header_size + samples.size() * PatternDataset::record_size;
+        for (size_t k = 0; k < 72 && layout; k++) {
+            layout = bool((record[k / 8] >> (k % 8)) & 1) == samples[0].first[k];
+        }
+        for (size_t k = 0; k < 9 && layout; k++) {
+            layout = bool((record[9 + k / 8] >> (k % 8)) & 1) == samples[0].second[k];
+        }
+
+        PatternDataset loaded;
+        bool ok = loaded.load(filename) && loaded.samples() == samples;
+        std::ofstream(filename, std::ios::binary)
+            .write(reinterpret_cast<const char *>(bytes.data()), std::streamsize(bytes.size() - 1));
+        bool truncated = loaded.load(filename);
+        std::remove(filename.c_str());
+        if (!layout || !ok || truncated || !loaded.empty()) {
+            std::cout << "Error: pattern dataset file round trip failed" << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "All pattern_dataset test passed!" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include <bitset>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <nn.hpp>
+#include <pattern_table.hpp>
+
+using NN = NeuralNetwork<72, 2, 16, 9, ActivationFunction::Sigmoid>;
+using Sample = PatternDataset::Sample;
+
+int main() {
+    std::mt19937 gen(8);
+    std::vector<Sample> samples(2000);
+    for (auto &[input, output] : samples) {
+        for (size_t i = 0; i < 72; i++) {
+            input[i] = gen() % 2;
+        }
+        output = std::bitset<9>(gen() % 512);
+    }
+    // повтор входа с другим выходом: таблица берёт большинство
+    samples.push_back({samples[0].first, samples[0].second});
+    samples.push_back({samples[0].first, ~samples[0].second});
+    samples.push_back({samples[0].first, samples[0].second});
+
+    PatternTable table{PatternDataset(samples)};
+    if (table.size() != 2000) {
+        std::cout << "Error: table has " << table.size() << " patterns instead of 2000" << std::endl;
+        return 1;
+    }
+    for (size_t k = 0; k < 2000; k++) {
+        auto found = table.find(samples[k].first);
+        if (!found || *found != samples[k].second) {
+            std::cout << "Error: known pattern " << k << " is not found" << std::endl;
+            return 1;
+        }
+    }
+
+    // неизвестные паттерны уходят в сеть, поштучно и батчем
+    NN nn(1);
+    PatternLookup<NN> lookup(table, nn);
+    std::vector<std::bitset<72>> inputs;
+    for (size_t k = 0; k < 300; k++) {
+        std::bitset<72> unseen;
+        for (size_t i = 0; i < 72; i++) {
+            unseen[i] = gen() % 2;
+        }
+        inputs.push_back(k % 3 == 0 ? unseen : samples[k].first);
+    }
+    LookupStats stats;
+    for (const auto &input : inputs) {
+        auto known = table.find(input);
+        if (lookup.Apply(input, &stats) != (known ? *known : nn.Apply(input))) {
+            std::cout << "Error: lookup does not fall back to the network" << std::endl;
+            return 1;
+        }
+    }
+    if (stats.hits != 200 || stats.misses != 100) {
+        std::cout << "Error: wrong hit statistics " << stats.hits << "/" << stats.misses << std::endl;
+        return 1;
+    }
+
+    PatternLookup<NN>::Workspace ws;
+    NN::BatchWorkspace nn_ws;
+    std::vector<double> probabilities(inputs.size() * 9), expected(inputs.size() * 9);
+    lookup.ApplyBatch(inputs.data(), inputs.size(), probabilities.data(), ws);
+    nn.ApplyBatch(inputs.data(), inputs.size(), expected.data(), nn_ws);
+    for (size_t b = 0; b < inputs.size(); b++) {
+        auto known = table.find(inputs[b]);
+        for (size_t o = 0; o < 9; o++) {
+            double want = known ? double((*known)[o]) : expected[b * 9 + o];
+            if (std::abs(probabilities[b * 9 + o] - want) > 1e-12) {
+                std::cout << "Error: batch lookup differs at sample " << b << std::endl;
+                return 1;
+            }
+        }
+    }
+    if (std::abs(ws.stats.hit_rate() - 2.0 / 3) > 1e-12) {
+        std::cout << "Error: hit rate " << ws.stats.hit_rate() << " instead of 2/3" << std::endl;
+        return 1;
+    }
+
+    std::cout << "All pattern_table test passed!" << std::endl;
+
+    return 0;
+}
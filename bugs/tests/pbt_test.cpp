@@ -0,0 +1,61 @@
+#include <bitset>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <pbt.hpp>
+
+#include "test_data.hpp"
+
+using NN = NeuralNetwork<72, 2, 16, 9, ActivationFunction::Sigmoid, float>;
+
+int main() {
+    std::mt19937 gen(5);
+    auto train = test_data::bit_dataset<NN>(512, gen);
+    auto validation = test_data::bit_dataset<NN>(128, gen);
+
+    ThreadPool pool(4);
+    PopulationOptions options;
+    options.population = 8;
+    options.steps_per_round = 32;
+    options.train.batch_size = 16;
+    options.seed = 1;
+    PopulationTrainer<NN> trainer(train, validation, options, pool);
+
+    double first = trainer.Round();
+    double last = first;
+    for (int round = 0; round < 30; round++) {
+        last = trainer.Round();
+    }
+    if (!(last < first) || !trainer.best()) {
+        std::cout << "Error: population does not improve: " << first << " -> " << last << std::endl;
+        return 1;
+    }
+    if (std::abs(trainer.best()->Error(validation) - last) > 1e-6 * last) {
+        std::cout << "Error: best network does not match the best validation error" << std::endl;
+        return 1;
+    }
+
+    // после отбора худшие - копии лучших, их гиперпараметры отличаются от источника в perturb раз
+    size_t copies = 0;
+    const auto &members = trainer.members();
+    for (const auto &a : members) {
+        for (const auto &b : members) {
+            double ratio = a.learning_rate / b.learning_rate;
+            bool perturbed = std::abs(ratio - options.perturb) < 1e-9 || std::abs(ratio - 1 / options.perturb) < 1e-9;
+            if (&a != &b && perturbed && a.net.Error(validation) == b.net.Error(validation)) {
+                copies++;
+            }
+        }
+    }
+    if (copies < 2) {
+        std::cout << "Error: weakest members were not replaced by perturbed copies" << std::endl;
+        return 1;
+    }
+
+    std::cout << "All pbt test passed!" << std::endl;
+
+    return 0;
+}
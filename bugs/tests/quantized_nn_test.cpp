@@ -0,0 +1,55 @@
+#include <bitset>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <quantized_nn.hpp>
+
+#include "test_data.hpp"
+
+using NN = NeuralNetwork<72, 2, 32, 9, ActivationFunction::Sigmoid>;
+using QNN = QuantizedNetwork<72, 2, 32, 9, ActivationFunction::Sigmoid>;
+
+int main() {
+    std::mt19937 gen(11);
+    auto train = test_data::bit_dataset<NN>(512, gen, std::bit_or<>());
+    auto held_out = test_data::bit_dataset<NN>(512, gen, std::bit_or<>());
+
+    NN nn;
+    nn.Train(train, 1.0, 100, 0, 0, 8);
+    QNN qnn(nn);
+
+    QuantizationReport report = CheckQuantization(nn, qnn, held_out);
+    std::cout << "Float score " << report.float_score << ", quantized score " << report.quantized_score
+              << ", agreement " << report.agreement << std::endl;
+    if (report.float_score < 0.5) {
+        std::cout << "Error: network did not learn the test function" << std::endl;
+        return 1;
+    }
+    if (std::abs(report.float_score - report.quantized_score) > 0.03 || report.agreement < 0.95) {
+        std::cout << "Error: quantized network is too far from the float one" << std::endl;
+        return 1;
+    }
+
+    // вероятности близки к исходным
+    NN::BatchWorkspace ws;
+    for (const auto &[input, target] : held_out) {
+        double expected[9];
+        float actual[9];
+        nn.ApplyBatch(&input, 1, expected, ws);
+        qnn.Probabilities(input, actual);
+        for (size_t i = 0; i < 9; i++) {
+            if (std::abs(expected[i] - actual[i]) > 0.1) {
+                std::cout << "Error: quantized probability " << actual[i] << " differs from " << expected[i]
+                          << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    std::cout << "All quantized nn test passed!" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <maze_evolver.hpp>
+#include <maze_utils.hpp>
+#include <score_cache.hpp>
+
+using namespace utils;
+
+// maze_utils.cpp в тесты не собирается; свой генератор, чтобы прогоны с кэшем и без шли по одним мутациям
+std::mt19937 test_gen;
+int utils::r() { return std::uniform_int_distribution<int>(0, 100000)(test_gen); }
+
+int main() {
+    ScoreCache cache(1000);
+    if (cache.capacity() != 1024) {
+        std::cout << "Error: capacity " << cache.capacity() << " instead of 1024" << std::endl;
+        return 1;
+    }
+    MazeScore found;
+    if (cache.find(0, found) || cache.find(42, found)) {
+        std::cout << "Error: empty cache returns a score" << std::endl;
+        return 1;
+    }
+    cache.insert(42, {1234, true});
+    cache.insert(43, {0, false});
+    if (!cache.find(42, found) || found.score != 1234 || !found.solvable) {
+        std::cout << "Error: cached score is lost" << std::endl;
+        return 1;
+    }
+    if (!cache.find(43, found) || found.score != 0 || found.solvable) {
+        std::cout << "Error: cached unsolvable maze is lost" << std::endl;
+        return 1;
+    }
+
+    // размер ограничен: после 100k ключей в таблице не больше capacity записей, и ни одна не искажена
+    for (uint64_t key = 0; key < 100000; key++) {
+        cache.insert(key * 0x9E3779B97F4A7C15ULL, {size_t(key), key % 2 == 0});
+    }
+    size_t kept = 0;
+    for (uint64_t key = 0; key < 100000; key++) {
+        if (cache.find(key * 0x9E3779B97F4A7C15ULL, found)) {
+            kept++;
+            if (found.score != key || found.solvable != (key % 2 == 0)) {
+                std::cout << "Error: key " << key << " returns a wrong score" << std::endl;
+                return 1;
+            }
+        }
+    }
+    if (kept == 0 || kept > cache.capacity()) {
+        std::cout << "Error: " << kept << " scores kept with capacity " << cache.capacity() << std::endl;
+        return 1;
+    }
+
+    // несколько потоков пишут в одни и те же слоты: найденное значение всегда соответствует ключу
+    cache.clear();
+    std::vector<std::thread> threads;
+    std::vector<int> errors(4, 0), hits(4, 0);
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&, t]() {
+            std::mt19937_64 gen(t);
+            MazeScore score;
+            for (int i = 0; i < 200000; i++) {
+                uint64_t key = gen() % 5000 + 1;
+                if (cache.find(key, score)) {
+                    hits[t]++;
+                    errors[t] += score.score != key * 3 || score.solvable != (key % 3 == 0);
+                } else {
+                    cache.insert(key, {size_t(key * 3), key % 3 == 0});
+                }
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    for (int e : errors) {
+        if (e) {
+            std::cout << "Error: concurrent readers got " << e << " wrong scores" << std::endl;
+            return 1;
+        }
+    }
+    if (std::find(hits.begin(), hits.end(), 0) != hits.end()) {
+        std::cout << "Error: a concurrent reader never hit the cache" << std::endl;
+        return 1;
+    }
+
+    // hill climb с кэшем проходит ровно тот же путь, что и без него, но часть оценок берёт из кэша
+    test_gen.seed(5);
+    MazeEvolver<9, 11> plain;
+    plain.evolve(300);
+    ScoreCache shared(1 << 12);
+    test_gen.seed(5);
+    MazeEvolver<9, 11> cached;
+    cached.set_score_cache(&shared);
+    WorkerCounters counters;
+    cached.evolve(300, &counters);
+    if (plain.get_score() != cached.get_score() || maze_to_bitset<9, 11>(plain.m) != maze_to_bitset<9, 11>(cached.m)) {
+        std::cout << "Error: cached evolver diverged: score " << cached.get_score() << " instead of "
+                  << plain.get_score() << std::endl;
+        return 1;
+    }
+    CountersSnapshot stats(counters);
+    if (stats.cache_hits == 0 || stats.pass_maze_calls + stats.cache_hits < 300) {
+        std::cout << "Error: evolver cache hits " << stats.cache_hits << ", pass_maze calls " << stats.pass_maze_calls
+                  << std::endl;
+        return 1;
+    }
+
+    // ключ Zobrist, который ведут мутации и increment_maze, совпадает с посчитанным с нуля
+    if (cached.get_key() != zobrist_key<9, 11>(cached.m) || cached.get_key() == 0) {
+        std::cout << "Error: incremental key of the evolver differs from zobrist_key" << std::endl;
+        return 1;
+    }
+    maze<9, 11> m;
+    prepare_maze<9, 11>(m);
+    uint64_t key = 0;
+    for (int i = 0; i < 5000; i++) {
+        increment_maze<9, 11>(m, key);
+        if (key != zobrist_key<9, 11>(m)) {
+            std::cout << "Error: increment_maze key differs from zobrist_key at step " << i << std::endl;
+            return 1;
+        }
+    }
+    Mutation<5, 9, 11> mutation;
+    uint64_t before = key;
+    mutation.apply(m, key);
+    if (key != zobrist_key<9, 11>(m)) {
+        std::cout << "Error: mutation key differs from zobrist_key" << std::endl;
+        return 1;
+    }
+    mutation.apply(m, key);
+    if (key != before) {
+        std::cout << "Error: undone mutation does not restore the key" << std::endl;
+        return 1;
+    }
+
+    std::cout << "All score_cache test passed! Evolver hit rate " << stats.cache_hit_rate() * 100 << "%" << std::endl;
+    return 0;
+}
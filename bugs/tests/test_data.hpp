@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Генераторы тестовых данных, общие для тестов и бенчмарков
+namespace test_data {
+
+constexpr int rows = 21, cols = 31, cells = rows * cols;
+
+// первые две плоскости сэмпла get_sample: стенки и шаги в свободных клетках
+inline std::vector<float> random_planes(std::mt19937 &gen) {
+    std::uniform_int_distribution<int> bit(0, 1);
+    std::uniform_real_distribution<float> steps(0, 1);
+    std::vector<float> planes(cells * 2, 0.f);
+    for (int k = 0; k < cells; k++) {
+        planes[k] = bit(gen);
+        planes[cells + k] = planes[k] ? 0.f : steps(gen);
+    }
+    return planes;
+}
+
+// Сэмпл той же структуры, что и у get_sample, на плоскостях planes: квадрат 3x3 в случайной позиции,
+// выход - стенки в квадрате, чтобы его можно было выучить
+inline std::pair<std::vector<float>, std::vector<float>> window_sample(const std::vector<float> &planes,
+                                                                       std::mt19937 &gen) {
+    std::vector<float> input(planes);
+    input.resize(cells * 3, 0.f);
+    int x = 2 + gen() % 17;
+    int y = 2 + gen() % 27;
+    std::vector<float> output;
+    for (int i = x - 1; i <= x + 1; i++) {
+        for (int j = y - 1; j <= y + 1; j++) {
+            input[2 * cells + i * cols + j] = 1;
+            output.push_back(input[i * cols + j]);
+        }
+    }
+    return {input, output};
+}
+
+inline std::pair<std::vector<float>, std::vector<float>> random_sample(std::mt19937 &gen) {
+    return window_sample(random_planes(gen), gen);
+}
+
+// Сэмплы Net::Sample для сетей на битовых входах: входы случайные, выход i - combine(input[i], input[i + Outputs]),
+// простая функция входа, которую сеть может выучить
+template <typename Net, typename Combine = std::bit_xor<>>
+std::vector<typename Net::Sample> bit_dataset(std::size_t size, std::mt19937 &gen, Combine combine = {}) {
+    std::vector<typename Net::Sample> dataset(size);
+    for (auto &[input, output] : dataset) {
+        for (std::size_t i = 0; i < Net::Inputs; i++) {
+            input[i] = gen() % 2;
+        }
+        for (std::size_t i = 0; i < Net::Outputs; i++) {
+            output[i] = combine(bool(input[i]), bool(input[(i + Net::Outputs) % Net::Inputs]));
+        }
+    }
+    return dataset;
+}
+
+} // namespace test_data